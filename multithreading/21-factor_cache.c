@@ -0,0 +1,138 @@
+#include "multithreading.h"
+#include <string.h>
+
+/*
+ * Bounded memo of factorizations, shared by every thread.
+ * Only cofactors left after trial division are cached: they are the
+ * expensive part, and every multiple of a cached number by small primes
+ * reduces to the same cofactor. The cache is split into FACTOR_CACHE_SHARDS
+ * independently locked shards of FACTOR_CACHE_SETS sets; a number may only
+ * live in the FACTOR_CACHE_WAYS slots of its set, and a CLOCK hand per set
+ * picks the slot to evict.
+ */
+
+#define CACHE_HASH(n) ((n) * 0x9E3779B97F4A7C15UL)
+#define CACHE_SHARD(h) ((h) >> 32 & (FACTOR_CACHE_SHARDS - 1))
+#define CACHE_SET(h) ((h) >> 40 & (FACTOR_CACHE_SETS - 1))
+
+static factor_shard_t factor_shards[FACTOR_CACHE_SHARDS];
+
+/**
+ * factor_cache_init - initializes the lock of every shard
+ */
+__attribute__((constructor)) void factor_cache_init(void)
+{
+	size_t i;
+
+	for (i = 0; i < FACTOR_CACHE_SHARDS; i++)
+		pthread_mutex_init(&factor_shards[i].lock, NULL);
+}
+
+/**
+ * factor_cache_get - looks a number up in the cache
+ * @n: number, never 0
+ * @factors: output array, factors are appended to it on a hit
+ * @count: number of factors in the array, updated on a hit
+ * Return: 1 on a hit, 0 on a miss
+ */
+int factor_cache_get(uint64_t n, uint64_t *factors, size_t *count)
+{
+	uint64_t h = CACHE_HASH(n);
+	factor_shard_t *shard = factor_shards + CACHE_SHARD(h);
+	factor_entry_t *set = shard->sets[CACHE_SET(h)].ways;
+	size_t i;
+
+	pthread_mutex_lock(&shard->lock);
+	for (i = 0; i < FACTOR_CACHE_WAYS && set[i].n != n; i++)
+		;
+	if (i < FACTOR_CACHE_WAYS)
+	{
+		set[i].ref = 1;
+		memcpy(factors + *count, set[i].factors,
+			sizeof(*factors) * set[i].count);
+		*count += set[i].count;
+		shard->stats.hits++;
+	}
+	else
+		shard->stats.misses++;
+	pthread_mutex_unlock(&shard->lock);
+	return (i < FACTOR_CACHE_WAYS);
+}
+
+/**
+ * factor_cache_put - stores the factorization of a number
+ * @n: number, never 0
+ * @factors: its prime factors
+ * @count: number of factors, at most FACTOR_CACHE_MAX_FACTORS
+ */
+void factor_cache_put(uint64_t n, uint64_t const *factors, size_t count)
+{
+	uint64_t h = CACHE_HASH(n);
+	factor_shard_t *shard = factor_shards + CACHE_SHARD(h);
+	factor_set_t *set = shard->sets + CACHE_SET(h);
+	factor_entry_t *e;
+	size_t i;
+
+	if (count > FACTOR_CACHE_MAX_FACTORS)
+		return;
+	pthread_mutex_lock(&shard->lock);
+	for (i = 0; i < FACTOR_CACHE_WAYS && set->ways[i].n != n; i++)
+		;
+	if (i < FACTOR_CACHE_WAYS) /* Stored meanwhile by another thread */
+		e = set->ways + i;
+	else
+	{
+		for (;; set->hand = (set->hand + 1) % FACTOR_CACHE_WAYS)
+		{
+			e = set->ways + set->hand;
+			if (!e->n || !e->ref)
+				break;
+			e->ref = 0; /* Second chance */
+		}
+		set->hand = (set->hand + 1) % FACTOR_CACHE_WAYS;
+		shard->stats.evictions += e->n != 0;
+		shard->stats.insertions++;
+	}
+	e->n = n;
+	e->ref = 1;
+	e->count = count;
+	memcpy(e->factors, factors, sizeof(*factors) * count);
+	pthread_mutex_unlock(&shard->lock);
+}
+
+/**
+ * factor_cache_stats - sums the counters of every shard
+ * @stats: where to store the counters
+ */
+void factor_cache_stats(factor_cache_stats_t *stats)
+{
+	size_t i;
+
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < FACTOR_CACHE_SHARDS; i++)
+	{
+		pthread_mutex_lock(&factor_shards[i].lock);
+		stats->hits += factor_shards[i].stats.hits;
+		stats->misses += factor_shards[i].stats.misses;
+		stats->insertions += factor_shards[i].stats.insertions;
+		stats->evictions += factor_shards[i].stats.evictions;
+		pthread_mutex_unlock(&factor_shards[i].lock);
+	}
+}
+
+/**
+ * factor_cofactor - factors what trial division left over, through the cache
+ * @n: number without factors below TRIAL_DIVISION_LIMIT
+ * @factors: output array, factors are appended to it, unordered
+ * @count: number of factors in the array, updated in place
+ */
+void factor_cofactor(uint64_t n, uint64_t *factors, size_t *count)
+{
+	size_t from = *count;
+
+	if (factor_cache_get(n, factors, count))
+		return;
+	split_factors(n, factors, count);
+	if (!task_should_stop()) /* Do not cache a partial factorization */
+		factor_cache_put(n, factors + from, *count - from);
+}
@@ -0,0 +1,148 @@
+#include "multithreading.h"
+
+#define RHO_BATCH 128 /* Differences multiplied together between two gcds */
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define ABS_DIFF(a, b) ((a) > (b) ? (a) - (b) : (b) - (a))
+
+/**
+ * rho_step - one step of the pseudo-random walk y -> y^2 + c (mod n)
+ * @y: current value, in Montgomery form
+ * @c: walk constant, reduced modulo n
+ * @m: Montgomery context
+ * Return: next value of the walk
+ */
+static uint64_t rho_step(uint64_t y, uint64_t c, mont_t const *m)
+{
+	uint64_t s = mont_mul(y, y, m), t = s + c;
+
+	return (t < s || t >= m->n ? t - m->n : t);
+}
+
+/**
+ * pollard_brent - Pollard's rho with Brent's cycle detection
+ * @n: odd composite number to split
+ * @c: walk constant; retry with another one when n is returned
+ * @stop: if not NULL, polled between batches; the walk gives up once set,
+ *        or once the task running it should stop
+ * Return: a divisor of n, n itself when this walk failed or was stopped
+ */
+uint64_t pollard_brent(uint64_t n, uint64_t c, int const *stop)
+{
+	uint64_t x, y = 2, ys = 2, q, g = 1, r, k, i;
+	mont_t m;
+
+	mont_init(&m, n);
+	c %= n;
+	q = m.one;
+	for (r = 1; g == 1; r <<= 1)
+	{
+		x = y;
+		for (i = 0; i < r; i++)
+			y = rho_step(y, c, &m);
+		for (k = 0; k < r && g == 1; k += RHO_BATCH)
+		{
+			if ((stop && __atomic_load_n(stop, __ATOMIC_RELAXED)) ||
+				task_should_stop())
+				return (n);
+			ys = y;
+			for (i = 0; i < MIN(RHO_BATCH, r - k); i++)
+			{
+				y = rho_step(y, c, &m);
+				q = mont_mul(q, ABS_DIFF(x, y), &m);
+			}
+			g = gcd_u64(q, n);
+		}
+	}
+	if (g == n) /* The batch overshot, walk it again one step at a time */
+		do {
+			ys = rho_step(ys, c, &m);
+			g = gcd_u64(ABS_DIFF(x, ys), n);
+		} while (g == 1);
+	return (g);
+}
+
+/**
+ * split_factors - recursively splits n into prime factors
+ * @n: number without factors below TRIAL_DIVISION_LIMIT
+ * @factors: output array
+ * @count: number of factors already in the array
+ */
+void split_factors(uint64_t n, uint64_t *factors, size_t *count)
+{
+	uint64_t d, c;
+
+	if (n == 1)
+		return;
+	if (is_prime_u64(n))
+	{
+		factors[(*count)++] = n;
+		return;
+	}
+	for (c = 1, d = n; d == n; c++)
+	{
+		d = pollard_brent(n, c, NULL);
+		if (d == n && task_should_stop())
+			return; /* Leaves the factorization incomplete */
+	}
+	split_factors(d, factors, count);
+	split_factors(n / d, factors, count);
+}
+
+/**
+ * trial_divide - removes the prime factors up to limit from n, using the
+ * shared prime table and then the mod-30 wheel past its end
+ * @n: number to divide, updated in place
+ * @limit: largest divisor to try, at most 2^32 - 1
+ * @factors: output array
+ * Return: number of factors found
+ */
+size_t trial_divide(uint64_t *n, uint64_t limit, uint64_t *factors)
+{
+	static uint32_t const wheel_primes[] = {2, 3, 5};
+	size_t count = 0, nb_primes, i;
+	uint32_t const *primes = prime_table(&nb_primes);
+	uint64_t p = 5;
+
+	if (!primes) /* Out of memory, the wheel alone still works */
+		primes = wheel_primes, nb_primes = 3;
+	for (i = 0; i < nb_primes; i++)
+	{
+		p = primes[i];
+		if (p > limit || p * p > *n)
+			return (count);
+		while (*n % p == 0)
+		{
+			factors[count++] = p;
+			*n /= p;
+		}
+	}
+	wheel_divide(n, p, limit, factors, &count);
+	return (count);
+}
+
+/**
+ * factor_u64 - factors a number into its prime factors
+ * Tiny factors are removed by trial division, the rest is looked up in the
+ * factor cache, or split with Pollard-rho and checked with Miller-Rabin.
+ * @n: number to factor
+ * @factors: output array, holding at least MAX_FACTORS elements
+ * Return: number of factors, stored in ascending order
+ */
+size_t factor_u64(uint64_t n, uint64_t *factors)
+{
+	size_t count = trial_divide(&n, TRIAL_DIVISION_LIMIT, factors), i, j;
+	uint64_t tmp;
+
+	if (n >= 2 && n / TRIAL_DIVISION_LIMIT < TRIAL_DIVISION_LIMIT)
+		factors[count++] = n;
+	else if (n >= 2)
+		factor_cofactor(n, factors, &count);
+
+	for (i = 1; i < count; i++)
+	{
+		for (j = i, tmp = factors[i]; j && factors[j - 1] > tmp; j--)
+			factors[j] = factors[j - 1];
+		factors[j] = tmp;
+	}
+	return (count);
+}
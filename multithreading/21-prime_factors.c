@@ -1,35 +1,34 @@
 #include "multithreading.h"
+#include "21-prime_factors_helpers.c"
+#include "21-pollard_rho.c"
+#include "21-prime_sieve.c"
+#include "21-factor_cache.c"
+#include "21-task_cancel.c"
 #include <stdlib.h>
 
 /**
  * prime_factors - factors a number into a list of prime factors
  * @s: string representation of the number to factor
- * Return: list_t of prime factors
+ * Return: list_t of prime factors, NULL if the task running it was
+ *         cancelled or timed out
  **/
 list_t *prime_factors(char const *s)
 {
-	unsigned long n = strtoul(s, NULL, 10);
-	unsigned long *tmp, p = 2;
-	list_t *list = malloc(sizeof(list_t));
+	uint64_t factors[MAX_FACTORS];
+	size_t i, count = factor_u64(strtoul(s, NULL, 10), factors);
+	unsigned long *tmp;
+	list_t *list;
 
+	if (task_should_stop())
+		return (NULL);
+	list = malloc(sizeof(list_t));
+	if (!list)
+		return (NULL);
 	list_init(list);
-	while (p * p <= n)
-	{
-		while (n % p == 0)
-		{
-			tmp = malloc(sizeof(unsigned long));
-			*tmp = p;
-			list_add(list, (void *)tmp);
-			n /= p;
-		}
-
-		p += 1 + (p != 2);
-	}
-
-	if (n >= 2)
+	for (i = 0; i < count; i++)
 	{
 		tmp = malloc(sizeof(unsigned long));
-		*tmp = n;
+		*tmp = factors[i];
 		list_add(list, (void *)tmp);
 	}
 	return (list);
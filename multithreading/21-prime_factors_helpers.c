@@ -0,0 +1,118 @@
+#include "multithreading.h"
+
+/*
+ * Montgomery arithmetic and deterministic Miller-Rabin for 64-bit numbers.
+ * All operands of mont_mul() must already be reduced modulo m->n.
+ */
+
+/**
+ * mont_init - prepares a Montgomery context for an odd modulus
+ * @m: context to fill
+ * @n: odd modulus
+ */
+void mont_init(mont_t *m, uint64_t n)
+{
+	int i;
+
+	m->n = n;
+	m->inv = n; /* correct to 3 bits, each Newton step doubles that */
+	for (i = 0; i < 5; i++)
+		m->inv *= 2 - n * m->inv;
+	m->one = (0 - n) % n;
+	m->r2 = (uint128_t)m->one * m->one % n;
+}
+
+/**
+ * mont_mul - Montgomery product (REDC) of two residues
+ * @a: first factor, in Montgomery form
+ * @b: second factor, in Montgomery form
+ * @m: Montgomery context
+ * Return: a * b * R^-1 mod n
+ */
+uint64_t mont_mul(uint64_t a, uint64_t b, mont_t const *m)
+{
+	uint128_t t = (uint128_t)a * b;
+	uint64_t hi = t >> 64, q = (uint64_t)t * m->inv;
+	uint64_t qn = ((uint128_t)q * m->n) >> 64;
+
+	return (hi < qn ? hi - qn + m->n : hi - qn);
+}
+
+/**
+ * mont_pow - modular exponentiation in Montgomery form
+ * @a: base, in Montgomery form
+ * @e: exponent
+ * @m: Montgomery context
+ * Return: a^e, in Montgomery form
+ */
+uint64_t mont_pow(uint64_t a, uint64_t e, mont_t const *m)
+{
+	uint64_t r = m->one;
+
+	for (; e; e >>= 1, a = mont_mul(a, a, m))
+		if (e & 1)
+			r = mont_mul(r, a, m);
+	return (r);
+}
+
+/**
+ * is_prime_u64 - deterministic Miller-Rabin primality test
+ * The first twelve primes as bases are enough for every n < 2^64.
+ * @n: number to test
+ * Return: 1 if n is prime, 0 otherwise
+ */
+int is_prime_u64(uint64_t n)
+{
+	static uint64_t const bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31,
+		37};
+	uint64_t d, x, minus_one;
+	size_t i;
+	int r, s;
+	mont_t m;
+
+	if (n < 2)
+		return (0);
+	for (i = 0; i < sizeof(bases) / sizeof(*bases); i++)
+		if (n % bases[i] == 0)
+			return (n == bases[i]);
+	mont_init(&m, n);
+	minus_one = n - m.one;
+	for (d = n - 1, s = 0; !(d & 1); d >>= 1)
+		s++;
+	for (i = 0; i < sizeof(bases) / sizeof(*bases); i++)
+	{
+		x = mont_pow(mont_mul(bases[i], m.r2, &m), d, &m);
+		if (x == m.one || x == minus_one)
+			continue;
+		for (r = 1; r < s && x != minus_one; r++)
+			x = mont_mul(x, x, &m);
+		if (x != minus_one)
+			return (0);
+	}
+	return (1);
+}
+
+/**
+ * gcd_u64 - binary greatest common divisor
+ * @a: first number
+ * @b: second number
+ * Return: gcd(a, b)
+ */
+uint64_t gcd_u64(uint64_t a, uint64_t b)
+{
+	int shift;
+	uint64_t t;
+
+	if (!a || !b)
+		return (a | b);
+	shift = __builtin_ctzll(a | b);
+	a >>= __builtin_ctzll(a);
+	while (b)
+	{
+		b >>= __builtin_ctzll(b);
+		if (a > b)
+			t = a, a = b, b = t;
+		b -= a;
+	}
+	return (a << shift);
+}
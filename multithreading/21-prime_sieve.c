@@ -0,0 +1,137 @@
+#include "multithreading.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Process-wide table of small primes, built once on first use by a segmented
+ * sieve of Eratosthenes and then shared read-only by every thread.
+ */
+
+#define SIEVE_SEGMENT 32768 /* Bytes sieved at a time, fits in L1 */
+
+static uint32_t *sieve_primes;
+static size_t sieve_count;
+static uint64_t sieve_bound = PRIME_SIEVE_BOUND;
+static pthread_once_t sieve_once = PTHREAD_ONCE_INIT;
+
+/**
+ * sieve_segment - sieves [low, low + SIEVE_SEGMENT) with the primes found so
+ * far; the first segment holds its own base primes and is sieved in place
+ * @seg: segment buffer, one byte per number
+ * @low: first number of the segment
+ */
+static void sieve_segment(char *seg, uint64_t low)
+{
+	uint64_t p, j;
+	size_t i;
+
+	memset(seg, 1, SIEVE_SEGMENT);
+	if (low == 0)
+	{
+		for (p = 2; p * p < SIEVE_SEGMENT; p++)
+			for (j = p * p; seg[p] && j < SIEVE_SEGMENT; j += p)
+				seg[j] = 0;
+		return;
+	}
+	for (i = 0; i < sieve_count; i++)
+	{
+		p = sieve_primes[i];
+		if (p * p >= low + SIEVE_SEGMENT)
+			break;
+		for (j = (low + p - 1) / p * p; j < low + SIEVE_SEGMENT; j += p)
+			seg[j - low] = 0;
+	}
+}
+
+/**
+ * sieve_build - fills the prime table with every prime up to sieve_bound
+ */
+static void sieve_build(void)
+{
+	char *seg = malloc(SIEVE_SEGMENT);
+	uint64_t low, n;
+	size_t cap = 1024;
+	uint32_t *tmp;
+
+	sieve_primes = malloc(sizeof(*sieve_primes) * cap);
+	for (low = 0; seg && sieve_primes && low <= sieve_bound;
+		low += SIEVE_SEGMENT)
+	{
+		sieve_segment(seg, low);
+		for (n = low < 2 ? 2 : low; n < low + SIEVE_SEGMENT; n++)
+		{
+			if (!seg[n - low] || n > sieve_bound)
+				continue;
+			if (sieve_count == cap)
+			{
+				tmp = realloc(sieve_primes,
+					sizeof(*tmp) * cap * 2);
+				if (!tmp)
+					break;
+				sieve_primes = tmp, cap *= 2;
+			}
+			sieve_primes[sieve_count++] = n;
+		}
+	}
+	free(seg);
+	if (!sieve_primes)
+		sieve_count = 0;
+}
+
+/**
+ * prime_table - returns the shared table of small primes, building it once
+ * @count: where to store the number of primes in the table
+ * Return: primes up to the configured bound, in ascending order
+ */
+uint32_t const *prime_table(size_t *count)
+{
+	pthread_once(&sieve_once, sieve_build);
+	*count = sieve_count;
+	return (sieve_primes);
+}
+
+/**
+ * prime_sieve_bound - sets the upper bound of the prime table
+ * Only effective before the first call to prime_table(), so it must be
+ * called before any thread starts factoring.
+ * @bound: largest number to sieve, between 30 and 2^32 - 1
+ * Return: the bound in use
+ */
+uint64_t prime_sieve_bound(uint64_t bound)
+{
+	if (!sieve_primes && bound >= 30 && bound <= 0xFFFFFFFFUL)
+		sieve_bound = bound;
+	return (sieve_bound);
+}
+
+/**
+ * wheel_divide - trial division by the numbers coprime to 30, i.e. by a
+ * mod-30 wheel, for divisors beyond the prime table
+ * @n: number to divide, updated in place
+ * @from: divisors up to this one have already been tried
+ * @limit: largest divisor to try
+ * @factors: output array
+ * @count: number of factors already in the array, updated in place
+ */
+void wheel_divide(uint64_t *n, uint64_t from, uint64_t limit,
+	uint64_t *factors, size_t *count)
+{
+	static uint64_t const wheel[] = {1, 7, 11, 13, 17, 19, 23, 29};
+	uint64_t base, p;
+	size_t i;
+
+	for (base = from / 30 * 30; base * base <= *n; base += 30)
+		for (i = 0; i < sizeof(wheel) / sizeof(*wheel); i++)
+		{
+			p = base + wheel[i];
+			if (p <= from || p == 1)
+				continue;
+			if (p > limit || p * p > *n)
+				return;
+			while (*n % p == 0)
+			{
+				factors[(*count)++] = p;
+				*n /= p;
+			}
+		}
+}
@@ -0,0 +1,64 @@
+#include "multithreading.h"
+#include <time.h>
+
+/*
+ * Cooperative cancellation: exec_tasks() records the task a thread is
+ * running, and long-running entries such as prime_factors() poll
+ * task_should_stop() and give up early, returning NULL.
+ */
+
+static __thread task_t *running_task;
+
+/**
+ * now_ns - reads the monotonic clock
+ * Return: CLOCK_MONOTONIC time in nanoseconds
+ */
+uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+/**
+ * set_current_task - records the task run by the calling thread
+ * @task: task, NULL once it returns
+ */
+void set_current_task(task_t *task)
+{
+	running_task = task;
+}
+
+/**
+ * current_task - gets the task run by the calling thread
+ * Return: the task, NULL outside of a task
+ */
+task_t *current_task(void)
+{
+	return (running_task);
+}
+
+/**
+ * task_stop_status - tells whether a task should stop, and why
+ * @task: task
+ * Return: CANCELLED or TIMEOUT if the task should stop, STARTED otherwise
+ */
+task_status_t task_stop_status(task_t const *task)
+{
+	if (task->cancel && __atomic_load_n(&task->cancel->cancelled,
+		__ATOMIC_RELAXED))
+		return (CANCELLED);
+	if (task->deadline && now_ns() >= task->deadline)
+		return (TIMEOUT);
+	return (STARTED);
+}
+
+/**
+ * task_should_stop - polled by task entries to honor cancellation
+ * Return: 1 if the task run by the calling thread should stop, 0 otherwise
+ */
+int task_should_stop(void)
+{
+	return (running_task && task_stop_status(running_task) != STARTED);
+}
@@ -1,5 +1,9 @@
 #include "multithreading.h"
 #include "22-prime_factors_helpers.c"
+#include "22-task_control.c"
+#include "22-task_priority.c"
+#include "22-task_stats.c"
+#include "22-task_stats_dump.c"
 #include <stdlib.h>
 
 /*
@@ -36,7 +40,13 @@ task_t *create_task(task_entry_t entry, void *param)
 		task->lock = tasks_mutex;
 		task->status = PENDING;
 		task->result = NULL;
-		task->id = id++;
+		task->id = __atomic_fetch_add(&id, 1, __ATOMIC_RELAXED);
+		task->flags = 0;
+		task->cancel = NULL;
+		task->deadline = 0;
+		task->priority = TASK_PRIO_NORMAL;
+		task->created = now_ns();
+		task_queued(task, 1);
 	}
 
 	return (task);
@@ -50,44 +60,44 @@ void destroy_task(task_t *task)
 {
 	if (task)
 	{
-		list_destroy(task->result, free);
+		task_queued(task, -1);
+		if (task->result)
+			list_destroy(task->result, free);
 		free(task->result);
 		free(task);
 	}
 }
 
 /**
- * exec_tasks - executes a list of tasks
+ * exec_tasks - executes a list of tasks, highest priority first
  * @tasks: NULL-terminated list of tasks
- * Return: ???
+ * Return: NULL once no task is pending
  **/
 void *exec_tasks(list_t const *tasks)
 {
-	int tasks_pending = 1, task_id;
-	node_t *node;
+	task_worker_stats_t *worker = task_worker();
+	uint64_t start = now_ns(), busy;
+	node_t *cursors[TASK_PRIO_MAX];
+	task_t *task;
+	int prio;
 
 	if (tasks == NULL)
 		pthread_exit(NULL);
 
-	while (tasks_pending)
-		for (tasks_pending = 0, node = tasks->head; node; node = node->next)
-			if (get_task_status(node->content) == PENDING)
-			{
-				tasks_pending = 1;
-				task_id = ((task_t *)node->content)->id;
-				set_task_status(node->content, STARTED);
-				tprintf("[%02d] Started\n", task_id);
-				if (exec_task(node->content))
-				{
-					set_task_status(node->content, SUCCESS);
-					tprintf("[%02d] Success\n", task_id);
-				}
-				else
-				{
-					set_task_status(node->content, FAILURE);
-					tprintf("[%02d] Failure\n", task_id);
-				}
-			}
+	for (prio = 0; prio < TASK_PRIO_MAX; prio++)
+		cursors[prio] = tasks->head;
+	busy = __atomic_load_n(&worker->busy_ns, __ATOMIC_RELAXED);
+	while ((task = pick_task(tasks, cursors)))
+		if (claim_task(task))
+			run_task(task);
+		else
+			__atomic_add_fetch(&worker->steals, 1,
+				__ATOMIC_RELAXED);
 
+	busy = __atomic_load_n(&worker->busy_ns, __ATOMIC_RELAXED) - busy;
+	/* Nested runs count as busy time of the outer task */
+	if (!current_task())
+		__atomic_add_fetch(&worker->idle_ns, now_ns() - start - busy,
+			__ATOMIC_RELAXED);
 	return (NULL);
 }
@@ -16,7 +16,7 @@ void *exec_task(task_t *task)
 	void *result;
 
 	result = task->entry(task->param);
-	pthread_mutex_lock(&task->lock);
+	task_lock(task);
 	task->result = result;
 	pthread_mutex_unlock(&task->lock);
 	return (result);
@@ -31,7 +31,7 @@ task_status_t get_task_status(task_t *task)
 {
 	task_status_t status;
 
-	pthread_mutex_lock(&task->lock);
+	task_lock(task);
 	status = task->status;
 	pthread_mutex_unlock(&task->lock);
 	return (status);
@@ -44,7 +44,68 @@ task_status_t get_task_status(task_t *task)
  */
 void set_task_status(task_t *task, task_status_t status)
 {
-	pthread_mutex_lock(&task->lock);
-	task->status = status;
+	task_lock(task);
+	__atomic_store_n(&task->status, status, __ATOMIC_RELEASE);
 	pthread_mutex_unlock(&task->lock);
 }
+
+/**
+ * claim_task - atomically moves a task from PENDING to STARTED, so that
+ *              two threads scanning the same list never run it twice
+ * @task: task
+ * Return: 1 if the calling thread now owns the task, 0 otherwise
+ */
+int claim_task(task_t *task)
+{
+	int claimed;
+
+	task_lock(task);
+	claimed = task->status == PENDING;
+	if (claimed)
+	{
+		task_dispatched(task);
+		__atomic_store_n(&task->status, STARTED, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&task->lock);
+	return (claimed);
+}
+
+/**
+ * run_task - runs a claimed task, logs and records its outcome
+ * A task cancelled or past its deadline is not started; one that stops
+ * early because of either returns NULL and gets CANCELLED or TIMEOUT.
+ * @task: task, already STARTED
+ */
+void run_task(task_t *task)
+{
+	static char const * const names[TASK_STATUS_MAX] = {"Pending",
+		"Started", "Success", "Failure", "Cancelled", "Timeout"};
+	int quiet = task->flags & TASK_QUIET;
+	task_status_t status = task_stop_status(task);
+	task_t *outer = current_task(); /* Set when tasks run tasks */
+	task_worker_stats_t *worker = task_worker();
+	uint64_t start;
+	void *result;
+
+	if (status == STARTED)
+	{
+		if (!quiet)
+			tprintf("[%02d] Started\n", task->id);
+		set_current_task(task);
+		start = now_ns();
+		result = exec_task(task);
+		start = now_ns() - start;
+		set_current_task(outer);
+		if (!outer)
+			__atomic_add_fetch(&worker->busy_ns, start,
+				__ATOMIC_RELAXED);
+		__atomic_add_fetch(&worker->tasks_run, 1, __ATOMIC_RELAXED);
+		task_hist_record(&worker->run_time, start);
+		status = result ? SUCCESS : task_stop_status(task);
+		if (status == STARTED)
+			status = FAILURE;
+	}
+	set_task_status(task, status);
+	if (!quiet)
+		tprintf("[%02d] %s\n", task->id, names[status]);
+}
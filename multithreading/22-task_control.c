@@ -0,0 +1,32 @@
+#include "multithreading.h"
+
+/**
+ * cancel_token_cancel - cancels every task holding a token
+ * Pending tasks are not started, running ones stop at their next poll.
+ * @token: token
+ */
+void cancel_token_cancel(cancel_token_t *token)
+{
+	__atomic_store_n(&token->cancelled, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * set_task_cancel - attaches a cancellation token to a task
+ * @task: pending task
+ * @token: token, may be shared with other tasks
+ */
+void set_task_cancel(task_t *task, cancel_token_t *token)
+{
+	task->cancel = token;
+}
+
+/**
+ * set_task_deadline - bounds the time a task may take
+ * The clock starts now, so the time spent pending counts too.
+ * @task: pending task
+ * @timeout_ns: time budget in nanoseconds, 0 to remove the deadline
+ */
+void set_task_deadline(task_t *task, uint64_t timeout_ns)
+{
+	task->deadline = timeout_ns ? now_ns() + timeout_ns : 0;
+}
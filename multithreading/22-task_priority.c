@@ -0,0 +1,146 @@
+#include "multithreading.h"
+
+/*
+ * Priority scheduling for exec_tasks(): the pending task with the best
+ * effective class runs first, the oldest breaking ties. A task gains one
+ * class for every TASK_AGING_NS it waits, so bulk work cannot starve.
+ * Every thread keeps a cursor per class on the first pending task of that
+ * class, in list order. Cursors only move forward, past tasks already
+ * started or of another class, so each thread walks the list once per
+ * class and a dispatch costs O(1) amortized. Only the task under each
+ * cursor, the oldest pending one of its class, is aged.
+ */
+
+static task_prio_stats_t prio_stats[TASK_PRIO_MAX];
+
+/**
+ * set_task_priority - sets the priority class of a pending task
+ * @task: pending task
+ * @priority: new class
+ */
+void set_task_priority(task_t *task, task_priority_t priority)
+{
+	if (priority >= TASK_PRIO_MAX || priority == task->priority)
+		return;
+	task_queued(task, -1);
+	task->priority = priority;
+	task_queued(task, 1);
+}
+
+/**
+ * task_level - computes the effective class of a pending task
+ * @task: task
+ * @now: current time, from now_ns()
+ * Return: its class, minus one per TASK_AGING_NS it has been waiting
+ */
+long task_level(task_t const *task, uint64_t now)
+{
+	uint64_t age;
+
+	age = now > task->created ? (now - task->created) / TASK_AGING_NS : 0;
+	if (age >= (uint64_t)task->priority)
+		return (0);
+	return ((long)(task->priority - age));
+}
+
+/**
+ * cursor_advance - moves the cursor of a class to its next pending task
+ * @cursor: cursor, NULL once past the end of the list
+ * @priority: class
+ * Return: the task under the cursor, NULL if there is none
+ */
+static task_t *cursor_advance(node_t **cursor, task_priority_t priority)
+{
+	task_t *task;
+
+	for (; *cursor; *cursor = (*cursor)->next)
+	{
+		task = (*cursor)->content;
+		if (task->priority == priority &&
+			__atomic_load_n(&task->status, __ATOMIC_ACQUIRE) ==
+			PENDING)
+			return (task);
+	}
+	return (NULL);
+}
+
+/**
+ * pick_task - finds the pending task that should run next
+ * A task whose class changed after the cursor of its new class went past
+ * it is found by rewinding the cursors, once no cursor has a task left.
+ * @tasks: list of tasks
+ * @cursors: TASK_PRIO_MAX cursors of the calling thread, all starting at
+ *           the head of the list
+ * Return: the task, NULL if none is pending
+ */
+task_t *pick_task(list_t const *tasks, node_t **cursors)
+{
+	uint64_t now = now_ns();
+	task_t *task, *best = NULL;
+	long level, best_level = TASK_PRIO_MAX;
+	int pass, prio;
+
+	for (pass = 0; !best && pass < 2; pass++)
+	{
+		for (prio = 0; pass && prio < TASK_PRIO_MAX; prio++)
+			cursors[prio] = tasks->head;
+		for (prio = 0; prio < TASK_PRIO_MAX; prio++)
+		{
+			task = cursor_advance(cursors + prio, prio);
+			if (!task)
+				continue;
+			level = task_level(task, now);
+			if (level < best_level || (level == best_level &&
+				task->created < best->created))
+				best = task, best_level = level;
+		}
+	}
+	return (best);
+}
+
+/**
+ * task_queued - updates the queue depth of the class of a pending task
+ * @task: task
+ * @delta: 1 when the task starts pending, -1 when it stops
+ */
+void task_queued(task_t const *task, long delta)
+{
+	if (__atomic_load_n(&task->status, __ATOMIC_ACQUIRE) == PENDING)
+		__atomic_add_fetch(&prio_stats[task->priority].depth, delta,
+			__ATOMIC_RELAXED);
+}
+
+/**
+ * task_dispatched - records the wait time of a task that just started
+ * @task: task, just claimed
+ */
+void task_dispatched(task_t const *task)
+{
+	task_prio_stats_t *stats = prio_stats + task->priority;
+	uint64_t wait = now_ns() - task->created, max;
+
+	__atomic_sub_fetch(&stats->depth, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats->dispatched, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats->wait_ns, wait, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&stats->max_wait_ns, __ATOMIC_RELAXED);
+	while (wait > max && !__atomic_compare_exchange_n(&stats->max_wait_ns,
+		&max, wait, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+	task_hist_record(&task_worker()->queue_wait, wait);
+}
+
+/**
+ * task_priority_stats - gets the queue metrics of a priority class
+ * @priority: class
+ * @stats: where to store the metrics
+ */
+void task_priority_stats(task_priority_t priority, task_prio_stats_t *stats)
+{
+	task_prio_stats_t *src = prio_stats + priority;
+
+	stats->depth = __atomic_load_n(&src->depth, __ATOMIC_RELAXED);
+	stats->dispatched = __atomic_load_n(&src->dispatched, __ATOMIC_RELAXED);
+	stats->wait_ns = __atomic_load_n(&src->wait_ns, __ATOMIC_RELAXED);
+	stats->max_wait_ns = __atomic_load_n(&src->max_wait_ns,
+		__ATOMIC_RELAXED);
+}
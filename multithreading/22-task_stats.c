@@ -0,0 +1,184 @@
+#include "multithreading.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Task system metrics. Every thread entering exec_tasks() owns a slot of
+ * counters and histograms; counters are only ever updated with relaxed
+ * atomic adds so task_stats_snapshot() may read them at any time. As the
+ * thread exits, its counters are merged into the retired ones and its slot
+ * is freed for the next thread.
+ */
+
+#define STAT_ADD(field, v) __atomic_add_fetch(&(field), (v), __ATOMIC_RELAXED)
+#define STAT_GET(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+static task_worker_stats_t task_workers[TASK_STATS_MAX_WORKERS];
+static unsigned int task_worker_users[TASK_STATS_MAX_WORKERS];
+static task_worker_stats_t task_retired;
+static size_t nb_task_workers; /* Slots used so far, free ones included */
+static pthread_mutex_t task_workers_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t task_worker_once = PTHREAD_ONCE_INIT;
+static pthread_key_t task_worker_key;
+static __thread task_worker_stats_t *task_worker_slot;
+
+/**
+ * hist_add - adds a live histogram to another one, and to a total
+ * @dst: histogram to add to
+ * @src: live histogram
+ * @total: histogram to add it to as well, or NULL
+ */
+static void hist_add(task_hist_t *dst, task_hist_t *src, task_hist_t *total)
+{
+	unsigned long n;
+	size_t b;
+
+	for (b = 0; b < TASK_HIST_BUCKETS; b++)
+	{
+		n = STAT_GET(src->buckets[b]);
+		dst->buckets[b] += n;
+		dst->count += n;
+		if (total)
+			total->buckets[b] += n, total->count += n;
+	}
+}
+
+/**
+ * worker_add - adds the counters of a live slot to other ones
+ * @dst: counters to add to
+ * @src: live slot
+ * @stats: snapshot whose merged histograms to add them to as well, or NULL
+ */
+static void worker_add(task_worker_stats_t *dst, task_worker_stats_t *src,
+	task_stats_t *stats)
+{
+	dst->tasks_run += STAT_GET(src->tasks_run);
+	dst->steals += STAT_GET(src->steals);
+	dst->busy_ns += STAT_GET(src->busy_ns);
+	dst->idle_ns += STAT_GET(src->idle_ns);
+	dst->lock_wait_ns += STAT_GET(src->lock_wait_ns);
+	hist_add(&dst->queue_wait, &src->queue_wait,
+		stats ? &stats->queue_wait : NULL);
+	hist_add(&dst->run_time, &src->run_time,
+		stats ? &stats->run_time : NULL);
+}
+
+/**
+ * task_worker_retire - frees the slot of a thread as it exits, once the
+ *                      last thread sharing it does, merging its counters
+ *                      into the retired ones
+ * @slot: slot of the thread
+ */
+static void task_worker_retire(void *slot)
+{
+	task_worker_stats_t *w = slot;
+
+	pthread_mutex_lock(&task_workers_lock);
+	if (!--task_worker_users[w - task_workers])
+	{
+		worker_add(&task_retired, w, NULL);
+		memset(w, 0, sizeof(*w));
+	}
+	pthread_mutex_unlock(&task_workers_lock);
+}
+
+/**
+ * task_worker_key_init - creates the key whose destructor frees the slots
+ */
+static void task_worker_key_init(void)
+{
+	pthread_key_create(&task_worker_key, task_worker_retire);
+}
+
+/**
+ * task_worker - gets the metrics slot of the calling thread
+ * Return: the slot, registered on first use: a free one, or the last one
+ *         if TASK_STATS_MAX_WORKERS threads hold one already
+ */
+task_worker_stats_t *task_worker(void)
+{
+	size_t i;
+
+	if (!task_worker_slot)
+	{
+		pthread_once(&task_worker_once, task_worker_key_init);
+		pthread_mutex_lock(&task_workers_lock);
+		for (i = 0; i < nb_task_workers && task_worker_users[i]; i++)
+			;
+		if (i == TASK_STATS_MAX_WORKERS)
+			i = TASK_STATS_MAX_WORKERS - 1;
+		else if (i == nb_task_workers)
+			nb_task_workers++;
+		task_worker_users[i]++;
+		task_worker_slot = task_workers + i;
+		task_worker_slot->thread = pthread_self();
+		pthread_mutex_unlock(&task_workers_lock);
+		pthread_setspecific(task_worker_key, task_worker_slot);
+	}
+	return (task_worker_slot);
+}
+
+/**
+ * task_hist_record - adds a duration to a histogram
+ * Durations below 2^(TASK_HIST_SUB_BITS + 1) ns get a bucket each, larger
+ * ones get 2^TASK_HIST_SUB_BITS buckets per power of two.
+ * @hist: histogram
+ * @ns: duration in nanoseconds
+ */
+void task_hist_record(task_hist_t *hist, uint64_t ns)
+{
+	size_t bucket = ns, e;
+
+	if (ns >> (TASK_HIST_SUB_BITS + 1))
+	{
+		e = 63 - __builtin_clzll(ns);
+		bucket = ((e - TASK_HIST_SUB_BITS + 1) << TASK_HIST_SUB_BITS) +
+			((ns >> (e - TASK_HIST_SUB_BITS)) &
+			((1 << TASK_HIST_SUB_BITS) - 1));
+	}
+	STAT_ADD(hist->buckets[bucket], 1);
+	STAT_ADD(hist->count, 1);
+}
+
+/**
+ * task_lock - locks a task, accounting the time spent waiting for it
+ * @task: task
+ */
+void task_lock(task_t *task)
+{
+	uint64_t start;
+
+	if (!pthread_mutex_trylock(&task->lock))
+		return;
+	start = now_ns();
+	pthread_mutex_lock(&task->lock);
+	STAT_ADD(task_worker()->lock_wait_ns, now_ns() - start);
+}
+
+/**
+ * task_stats_snapshot - copies the metrics of every worker
+ * Return: malloc'd snapshot, with the histograms of all workers merged in
+ *         queue_wait and run_time; NULL on allocation failure
+ */
+task_stats_t *task_stats_snapshot(void)
+{
+	size_t n = TASK_STATS_MAX_WORKERS, i;
+	task_worker_stats_t *w;
+	task_stats_t *stats;
+
+	stats = calloc(1, sizeof(*stats) + sizeof(*stats->workers) * n);
+	if (!stats)
+		return (NULL);
+	pthread_mutex_lock(&task_workers_lock);
+	for (i = 0; i < nb_task_workers; i++)
+		if (task_worker_users[i])
+		{
+			w = stats->workers + stats->nb_workers++;
+			memcpy(&w->thread, &task_workers[i].thread,
+				sizeof(pthread_t));
+			worker_add(w, task_workers + i, stats);
+		}
+	worker_add(&stats->retired, &task_retired, stats);
+	pthread_mutex_unlock(&task_workers_lock);
+	return (stats);
+}
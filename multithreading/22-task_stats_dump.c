@@ -0,0 +1,128 @@
+#include "multithreading.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Reporting side of the task system metrics, see 22-task_stats.c */
+
+static unsigned int dump_interval;
+static unsigned long dump_generation; /* Bumped to retire a dump thread */
+
+#define DUMP_CURRENT(gen) \
+	((void *)__atomic_load_n(&dump_generation, __ATOMIC_RELAXED) == (gen))
+
+/**
+ * task_hist_floor - gives the smallest duration of a histogram bucket
+ * @bucket: bucket index
+ * Return: duration in nanoseconds
+ */
+uint64_t task_hist_floor(size_t bucket)
+{
+	size_t sub = (size_t)1 << TASK_HIST_SUB_BITS, e;
+
+	if (bucket < 2 * sub)
+		return (bucket);
+	e = bucket / sub + TASK_HIST_SUB_BITS - 1;
+	return ((uint64_t)(sub + bucket % sub) << (e - TASK_HIST_SUB_BITS));
+}
+
+/**
+ * task_hist_percentile - estimates a percentile of a histogram
+ * @hist: histogram
+ * @q: quantile, between 0 and 1
+ * Return: lower bound of the bucket holding the percentile, in nanoseconds
+ */
+uint64_t task_hist_percentile(task_hist_t const *hist, double q)
+{
+	unsigned long target = q * hist->count, seen = 0;
+	size_t b;
+
+	for (b = 0; b < TASK_HIST_BUCKETS; b++)
+	{
+		seen += hist->buckets[b];
+		if (seen > target || (seen == hist->count && seen))
+			return (task_hist_floor(b));
+	}
+	return (0);
+}
+
+/**
+ * task_stats_dump - prints a snapshot of the task system metrics
+ * @stream: where to print
+ */
+void task_stats_dump(FILE *stream)
+{
+	task_stats_t *stats = task_stats_snapshot();
+	task_worker_stats_t const *w;
+	size_t i;
+
+	if (!stats)
+		return;
+	fprintf(stream, "%-16s %5s %6s %9s %9s %7s\n", "worker", "tasks",
+		"steals", "busy_ms", "idle_ms", "lock_ms");
+	for (i = 0; i < stats->nb_workers; i++)
+	{
+		w = stats->workers + i;
+		fprintf(stream, "%-16lx %5lu %6lu %9.3f %9.3f %7.3f\n",
+			(unsigned long)w->thread, w->tasks_run, w->steals,
+			w->busy_ns / 1e6, w->idle_ns / 1e6,
+			w->lock_wait_ns / 1e6);
+	}
+	w = &stats->retired;
+	if (w->tasks_run || w->steals || w->idle_ns)
+		fprintf(stream, "%-16s %5lu %6lu %9.3f %9.3f %7.3f\n",
+			"retired", w->tasks_run, w->steals, w->busy_ns / 1e6,
+			w->idle_ns / 1e6, w->lock_wait_ns / 1e6);
+	fprintf(stream, "queue wait us: p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+		task_hist_percentile(&stats->queue_wait, .5) / 1e3,
+		task_hist_percentile(&stats->queue_wait, .9) / 1e3,
+		task_hist_percentile(&stats->queue_wait, .99) / 1e3,
+		task_hist_percentile(&stats->queue_wait, 1) / 1e3);
+	fprintf(stream, "run time us:   p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+		task_hist_percentile(&stats->run_time, .5) / 1e3,
+		task_hist_percentile(&stats->run_time, .9) / 1e3,
+		task_hist_percentile(&stats->run_time, .99) / 1e3,
+		task_hist_percentile(&stats->run_time, 1) / 1e3);
+	free(stats);
+}
+
+/**
+ * dump_loop - thread entry printing the metrics to stderr periodically
+ * @generation: generation of this thread, cast to a pointer
+ * Return: NULL, once the dump is turned off or restarted
+ */
+static void *dump_loop(void *generation)
+{
+	while (DUMP_CURRENT(generation))
+	{
+		sleep(__atomic_load_n(&dump_interval, __ATOMIC_RELAXED));
+		if (DUMP_CURRENT(generation))
+			task_stats_dump(stderr);
+	}
+	return (NULL);
+}
+
+/**
+ * task_stats_dump_every - prints the metrics to stderr periodically
+ * @seconds: period, 0 to stop
+ * Return: 0 on success, -1 if the dump thread could not be started
+ */
+int task_stats_dump_every(unsigned int seconds)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	unsigned long generation;
+	int ret = 0;
+
+	if (__atomic_exchange_n(&dump_interval, seconds, __ATOMIC_RELAXED) &&
+		seconds)
+		return (0); /* Already running, it picks up the new period */
+	generation = __atomic_add_fetch(&dump_generation, 1, __ATOMIC_RELAXED);
+	if (!seconds)
+		return (0);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&thread, &attr, dump_loop, (void *)generation))
+		ret = -1, dump_interval = 0;
+	pthread_attr_destroy(&attr);
+	return (ret);
+}
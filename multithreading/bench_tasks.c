@@ -0,0 +1,492 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "multithreading.h"
+
+/*
+ * Baseline of the task system: runs create_task() / exec_tasks() /
+ * destroy_task() over synthetic workloads with 1 to N threads and reports
+ * throughput, latency percentiles and scaling efficiency.
+ *
+ *   noop    tasks returning at once, i.e. scheduler overhead
+ *   factor  prime_factors() on a mix of 20-, 40- and 62-bit inputs
+ *   skewed  busy loops of 10us (90%), 100us (9%) and 2ms (1%)
+ *   exec    the skewed loops on a task executor of at most that many
+ *           workers, grown with the backlog, which must be back to no
+ *           worker once idle
+ *   stream  the factor inputs streamed through such an executor, each
+ *           task being consumed and destroyed as soon as it finishes,
+ *           with at most 4 tasks per worker in flight
+ *
+ * make bench, or
+ * gcc -O2 -fcommon bench_tasks.c task_executor.c 22-prime_factors.c \
+ *     21-prime_factors.c list.c 20-tprintf.c -pthread
+ * ./a.out [max_threads] [nb_tasks] [seed]
+ *
+ * Latency is measured from the start of the run to the completion of each
+ * task, as seen by a caller waiting on the whole list. Inputs depend on the
+ * seed and the thread count only, so runs are repeatable and every thread
+ * count factors numbers the factor cache has not seen.
+ */
+
+/**
+ * struct bench_item_s - Parameter of a benchmark task
+ *
+ * @s:     Number to factor, for the factor workload
+ * @spin:  Busy time in ns, for the skewed workload
+ * @start: Start of the run
+ * @done:  Completion time of the task, relative to start
+ */
+typedef struct bench_item_s
+{
+	char s[24];
+	uint64_t spin;
+	uint64_t start;
+	uint64_t done;
+} bench_item_t;
+
+/**
+ * struct bench_result_s - Outcome of one run
+ *
+ * @rate: Tasks per second
+ * @p50:  Median latency in ns
+ * @p99:  99th percentile latency in ns
+ */
+typedef struct bench_result_s
+{
+	double rate;
+	uint64_t p50;
+	uint64_t p99;
+} bench_result_t;
+
+/**
+ * struct bench_stream_s - State of the consumer of a streaming run
+ *
+ * @entry:    Task entry of the run
+ * @consumed: Number of tasks consumed so far
+ * @failed:   Number of consumed tasks without a result
+ */
+typedef struct bench_stream_s
+{
+	task_entry_t entry;
+	size_t consumed;
+	size_t failed;
+} bench_stream_t;
+
+/**
+ * bench_run_t - runs one workload with a given number of threads
+ * @entry: task entry
+ * @items: task parameters, already filled
+ * @n: number of tasks
+ * @nb_threads: number of threads
+ * @res: where to store the outcome
+ * Return: 0 on success, -1 on failure
+ */
+typedef int (*bench_run_t)(task_entry_t entry, bench_item_t *items,
+	size_t n, size_t nb_threads, bench_result_t *res);
+
+/**
+ * bench_noop - task entry doing nothing
+ * @item: task parameter
+ * Return: a non-NULL pointer, for the task to succeed
+ */
+static void *bench_noop(bench_item_t *item)
+{
+	item->done = now_ns() - item->start;
+	return (item);
+}
+
+/**
+ * bench_factor - task entry factoring a number
+ * @item: task parameter
+ * Return: list of factors
+ */
+static void *bench_factor(bench_item_t *item)
+{
+	list_t *factors = prime_factors(item->s);
+
+	item->done = now_ns() - item->start;
+	return (factors);
+}
+
+/**
+ * bench_spin - task entry keeping a CPU busy
+ * @item: task parameter
+ * Return: a non-NULL pointer, for the task to succeed
+ */
+static void *bench_spin(bench_item_t *item)
+{
+	uint64_t end = now_ns() + item->spin;
+
+	while (now_ns() < end)
+		;
+	item->done = now_ns() - item->start;
+	return (item);
+}
+
+/**
+ * rng - xorshift64* generator
+ * @state: generator state, never 0
+ * Return: next random number
+ */
+static uint64_t rng(uint64_t *state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return (*state * 0x2545F4914F6CDD1DUL);
+}
+
+/**
+ * bench_inputs - fills the task parameters of a run
+ * @items: parameters
+ * @n: number of tasks
+ * @seed: seed of the run
+ */
+static void bench_inputs(bench_item_t *items, size_t n, uint64_t seed)
+{
+	static int const bits[] = {20, 40, 62};
+	uint64_t state = seed * 0x9E3779B97F4A7C15UL | 1, r;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		r = rng(&state);
+		sprintf(items[i].s, "%lu", (unsigned long)((r >> 2) &
+			((1UL << bits[i % 3]) - 1)) | 1UL << (bits[i % 3] - 1));
+		r %= 100;
+		items[i].spin = r < 90 ? 10000 : r < 99 ? 100000 : 2000000;
+	}
+}
+
+/**
+ * cmp_u64 - qsort comparator of uint64_t
+ * @a: first value
+ * @b: second value
+ * Return: negative, zero or positive as a is below, equal or above b
+ */
+static int cmp_u64(void const *a, void const *b)
+{
+	uint64_t x = *(uint64_t const *)a, y = *(uint64_t const *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * clear_result - forgets the result of a task, when it is not a list_t
+ * @task: task
+ */
+static void clear_result(task_t *task)
+{
+	task->result = NULL;
+}
+
+/**
+ * bench_result - computes the outcome of a run from its task completions
+ * @items: task parameters, completed
+ * @n: number of tasks
+ * @elapsed: duration of the run, in ns
+ * @res: where to store the outcome
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int bench_result(bench_item_t const *items, size_t n,
+	uint64_t elapsed, bench_result_t *res)
+{
+	uint64_t *lat = malloc(sizeof(*lat) * n);
+	size_t i;
+
+	if (!lat)
+		return (-1);
+	for (i = 0; i < n; i++)
+		lat[i] = items[i].done;
+	qsort(lat, n, sizeof(*lat), cmp_u64);
+	res->rate = elapsed ? n * 1e9 / elapsed : 0;
+	res->p50 = lat[n / 2];
+	res->p99 = lat[n * 99 / 100];
+	free(lat);
+	return (0);
+}
+
+/**
+ * bench_tasks - creates the tasks of a run
+ * @tasks: list to fill, initialized
+ * @entry: task entry
+ * @items: task parameters
+ * @n: number of tasks
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int bench_tasks(list_t *tasks, task_entry_t entry,
+	bench_item_t *items, size_t n)
+{
+	task_t *task;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		task = create_task(entry, items + i);
+		if (!task || !list_add(tasks, task))
+		{
+			destroy_task(task);
+			return (-1);
+		}
+		task->flags |= TASK_QUIET;
+	}
+	return (0);
+}
+
+/**
+ * bench_release - destroys the tasks of a run
+ * @tasks: tasks
+ * @entry: their entry
+ */
+static void bench_release(list_t *tasks, task_entry_t entry)
+{
+	if (entry != (task_entry_t)bench_factor)
+		list_each(tasks, (node_func_t)clear_result);
+	list_destroy(tasks, (node_func_t)destroy_task);
+}
+
+/**
+ * bench_run - runs one workload through exec_tasks()
+ * @entry: task entry
+ * @items: task parameters, already filled
+ * @n: number of tasks
+ * @nb_threads: number of threads, the calling thread included
+ * @res: where to store the outcome
+ * Return: 0 on success, -1 on failure
+ */
+static int bench_run(task_entry_t entry, bench_item_t *items, size_t n,
+	size_t nb_threads, bench_result_t *res)
+{
+	pthread_t *threads = malloc(sizeof(*threads) * nb_threads);
+	uint64_t start;
+	int ret = -1;
+	list_t tasks;
+	size_t i;
+
+	list_init(&tasks);
+	if (threads && !bench_tasks(&tasks, entry, items, n))
+	{
+		start = now_ns();
+		for (i = 0; i < n; i++)
+			items[i].start = start;
+		for (i = 1; i < nb_threads; i++)
+			if (pthread_create(threads + i, NULL,
+				(void *(*)(void *))exec_tasks, &tasks))
+				break;
+		ret = i == nb_threads ? 0 : -1;
+		nb_threads = i;
+		exec_tasks(&tasks);
+		for (i = 1; i < nb_threads; i++)
+			pthread_join(threads[i], NULL);
+		ret |= bench_result(items, n, now_ns() - start, res);
+	}
+	bench_release(&tasks, entry);
+	free(threads);
+	return (ret);
+}
+
+/**
+ * bench_idle - waits for the workers of an idle executor to exit
+ * Parked workers time out after EXECUTOR_IDLE_NS without work.
+ * @ex: executor, without unfinished tasks
+ * Return: 0 once it has no worker left, -1 if some are still there after
+ *         ten times that
+ */
+static int bench_idle(task_executor_t *ex)
+{
+	uint64_t end = now_ns() + EXECUTOR_IDLE_NS * 10;
+	size_t nb_workers;
+
+	do {
+		usleep(1000);
+		pthread_mutex_lock(&ex->lock);
+		nb_workers = ex->nb_workers;
+		pthread_mutex_unlock(&ex->lock);
+	} while (nb_workers && now_ns() < end);
+	return (nb_workers ? -1 : 0);
+}
+
+/**
+ * bench_exec - runs one workload on a task executor, which grows from no
+ * worker as the tasks are submitted and must shrink back once they are done
+ * @entry: task entry
+ * @items: task parameters, already filled
+ * @n: number of tasks
+ * @nb_threads: most workers of the executor, the caller only submitting
+ * @res: where to store the outcome
+ * Return: 0 on success, -1 on failure
+ */
+static int bench_exec(task_entry_t entry, bench_item_t *items, size_t n,
+	size_t nb_threads, bench_result_t *res)
+{
+	task_executor_t *ex = task_executor_create(nb_threads);
+	uint64_t start;
+	int ret = -1;
+	list_t tasks;
+	node_t *node;
+	size_t i;
+
+	list_init(&tasks);
+	if (ex && !bench_tasks(&tasks, entry, items, n))
+	{
+		start = now_ns();
+		for (i = 0; i < n; i++)
+			items[i].start = start;
+		for (node = tasks.head; node; node = node->next)
+			if (task_executor_submit(ex, node->content))
+				break;
+		task_executor_wait(ex);
+		ret = node ? -1 : bench_result(items, n, now_ns() - start, res);
+		if (!ret && bench_idle(ex))
+		{
+			fprintf(stderr, "exec: workers left once idle\n");
+			ret = -1;
+		}
+	}
+	task_executor_destroy(ex);
+	bench_release(&tasks, entry);
+	return (ret);
+}
+
+/**
+ * bench_consume - consumer of a streaming run
+ * @task: finished task, destroyed by the executor on return
+ * @stream: state of the run
+ */
+static void bench_consume(task_t *task, bench_stream_t *stream)
+{
+	if (!task->result)
+		stream->failed++;
+	if (stream->entry != (task_entry_t)bench_factor)
+		clear_result(task);
+	__atomic_add_fetch(&stream->consumed, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * bench_stream - runs one workload on a streaming task executor, creating
+ * each task only when the window lets it in
+ * @entry: task entry
+ * @items: task parameters, already filled
+ * @n: number of tasks
+ * @nb_threads: most workers of the executor, the caller only submitting
+ * @res: where to store the outcome
+ * Return: 0 on success, -1 on failure or if more tasks than the window were
+ *         ever in flight
+ */
+static int bench_stream(task_entry_t entry, bench_item_t *items, size_t n,
+	size_t nb_threads, bench_result_t *res)
+{
+	task_executor_t *ex = task_executor_create(nb_threads);
+	bench_stream_t stream = {entry, 0, 0};
+	size_t i, window = 4 * nb_threads, inflight = 0;
+	uint64_t start = now_ns();
+	task_t *task = NULL;
+	int ret = -1;
+
+	if (ex && !task_executor_stream(ex, (task_consumer_t)bench_consume,
+		&stream, window))
+	{
+		for (i = 0; i < n; i++)
+			items[i].start = start;
+		for (i = 0; i < n; i++)
+		{
+			task = create_task(entry, items + i);
+			if (!task)
+				break;
+			task->flags |= TASK_QUIET;
+			if (task_executor_submit(ex, task))
+				break;
+			task = NULL;
+			inflight = i + 1 - __atomic_load_n(&stream.consumed,
+				__ATOMIC_ACQUIRE);
+			if (inflight > window)
+				break;
+		}
+		destroy_task(task);
+		task_executor_wait(ex);
+		if (i == n && !stream.failed && stream.consumed == n)
+			ret = bench_result(items, n, now_ns() - start, res);
+		else
+			fprintf(stderr, "stream: %lu of %lu tasks consumed, "
+				"%lu failed, %lu in flight\n",
+				(unsigned long)stream.consumed,
+				(unsigned long)n, (unsigned long)stream.failed,
+				(unsigned long)inflight);
+	}
+	task_executor_destroy(ex);
+	return (ret);
+}
+
+/**
+ * bench_workload - runs a workload with 1 to max_threads threads, doubling
+ * the thread count every time, and prints one line per run
+ * @name: name of the workload
+ * @run: runs the workload with a given number of threads
+ * @entry: task entry
+ * @n: number of tasks
+ * @max_threads: largest thread count
+ * @seed: seed of the inputs
+ * Return: 0 on success, -1 on failure
+ */
+static int bench_workload(char const *name, bench_run_t run,
+	task_entry_t entry, size_t n, size_t max_threads, uint64_t seed)
+{
+	bench_item_t *items = calloc(n, sizeof(*items));
+	bench_result_t res, base = {0, 0, 0};
+	size_t t;
+
+	for (t = 1; items && t <= max_threads; t = t < max_threads &&
+		t * 2 > max_threads ? max_threads : t * 2)
+	{
+		bench_inputs(items, n, seed + t);
+		if (run(entry, items, n, t, &res))
+			break;
+		if (t == 1)
+			base = res;
+		printf("%-7s %3lu %12.0f %10.1f %10.1f %9.0f%%\n", name,
+			(unsigned long)t, res.rate, res.p50 / 1e3,
+			res.p99 / 1e3,
+			base.rate ? res.rate / base.rate / t * 100 : 0);
+		if (t == max_threads)
+			break;
+	}
+	free(items);
+	return (items && t == max_threads ? 0 : -1);
+}
+
+/**
+ * main - Entry point
+ *
+ * @ac: Arguments count
+ * @av: Arguments vector
+ *
+ * Return: EXIT_SUCCESS upon success, EXIT_FAILURE otherwise
+ */
+int main(int ac, char **av)
+{
+	size_t max_threads = ac > 1 ? strtoul(av[1], NULL, 10) : 4;
+	size_t n = ac > 2 ? strtoul(av[2], NULL, 10) : 5000, count;
+	uint64_t seed = ac > 3 ? strtoul(av[3], NULL, 10) : 42;
+	int ret = 0;
+
+	if (!max_threads || !n)
+		return (EXIT_FAILURE);
+	prime_table(&count); /* Build the table outside of the timings */
+	printf("%lu tasks per run, up to %lu threads, seed %lu\n",
+		(unsigned long)n, (unsigned long)max_threads,
+		(unsigned long)seed);
+	printf("%-7s %3s %12s %10s %10s %10s\n", "load", "thr", "tasks/s",
+		"p50 (us)", "p99 (us)", "efficiency");
+	ret |= bench_workload("noop", bench_run, (task_entry_t)bench_noop, n,
+		max_threads, seed);
+	ret |= bench_workload("factor", bench_run, (task_entry_t)bench_factor,
+		n, max_threads, seed);
+	ret |= bench_workload("skewed", bench_run, (task_entry_t)bench_spin, n,
+		max_threads, seed);
+	ret |= bench_workload("exec", bench_exec, (task_entry_t)bench_spin, n,
+		max_threads, seed);
+	ret |= bench_workload("stream", bench_stream,
+		(task_entry_t)bench_factor, n, max_threads, seed);
+	return (ret ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "multithreading.h"
+
+/*
+ * Compares the original trial division loop of prime_factors() with the
+ * prime table + mod-30 wheel, on random 40-bit inputs, then checks the
+ * output of prime_factors_batch() against prime_factors() on BATCH_CHECK
+ * inputs of random width, which span several chunks and end on a partial
+ * block of lanes. Last, prime_factors_parallel() factors PARALLEL_CHECK
+ * products of three 21-bit primes, each taking two splits.
+ *
+ * make bench_trial_division, or
+ * gcc -O2 -fcommon bench_trial_division.c prime_factors_batch.c \
+ *     prime_factors_parallel.c 22-prime_factors.c 21-prime_factors.c \
+ *     list.c 20-tprintf.c -pthread
+ * ./a.out [nb_inputs] [seed]
+ */
+
+#define BATCH_CHECK 10007 /* Prime, so a multiple of no chunk or block */
+#define PARALLEL_CHECK 200
+
+/**
+ * naive_divide - the original loop: every odd number up to sqrt(n)
+ * @n: number to factor
+ * @factors: output array
+ * Return: number of factors
+ */
+static size_t naive_divide(uint64_t n, uint64_t *factors)
+{
+	size_t count = 0;
+	uint64_t p = 2;
+
+	for (; p * p <= n; p += 1 + (p != 2))
+		while (n % p == 0)
+		{
+			factors[count++] = p;
+			n /= p;
+		}
+	if (n >= 2)
+		factors[count++] = n;
+	return (count);
+}
+
+/**
+ * table_divide - trial division through the prime table and the wheel
+ * @n: number to factor
+ * @factors: output array
+ * Return: number of factors
+ */
+static size_t table_divide(uint64_t n, uint64_t *factors)
+{
+	size_t count = trial_divide(&n, 0xFFFFFFFFUL, factors);
+
+	if (n >= 2)
+		factors[count++] = n;
+	return (count);
+}
+
+/**
+ * bench - times a factoring function over all inputs
+ * @name: name to print
+ * @f: factoring function
+ * @in: inputs
+ * @n: number of inputs
+ * Return: elapsed nanoseconds
+ */
+static double bench(char const *name, size_t (*f)(uint64_t, uint64_t *),
+	uint64_t const *in, size_t n)
+{
+	uint64_t factors[MAX_FACTORS], check = 0;
+	struct timespec t0, t1;
+	double ns;
+	size_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < n; i++)
+		check += f(in[i], factors);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+	printf("%-14s %12.0f ns/input  (%lu factors)\n", name, ns / n,
+		(unsigned long)check);
+	return (ns);
+}
+
+/**
+ * rand_width - draws a random number of random bit width
+ * Return: the number, from 0 to 2^64 - 1
+ */
+static uint64_t rand_width(void)
+{
+	uint64_t n = (uint64_t)rand() << 62 ^ (uint64_t)rand() << 31 ^ rand();
+
+	return (n >> rand() % 64);
+}
+
+/**
+ * check_input - compares the factors of one input in a batch with
+ * prime_factors()
+ * @n: input
+ * @f: its factors in the batch
+ * @count: number of factors in the batch
+ * Return: 1 if they match, 0 otherwise
+ */
+static int check_input(uint64_t n, uint64_t const *f, size_t count)
+{
+	char s[24];
+	list_t *factors;
+	node_t *node;
+	size_t i = 0;
+
+	sprintf(s, "%lu", (unsigned long)n);
+	factors = prime_factors(s);
+	if (!factors)
+		return (0);
+	for (node = factors->head; node && i < count; node = node->next, i++)
+		if (*(unsigned long *)node->content != f[i])
+			break;
+	i = !node && i == count;
+	list_destroy(factors, free);
+	free(factors);
+	return (i);
+}
+
+/**
+ * check_batch - factors random inputs with prime_factors_batch() and
+ * compares every run of its output with prime_factors()
+ * @nb_threads: threads of the batch
+ * Return: 0 if every input matches, -1 otherwise
+ */
+static int check_batch(size_t nb_threads)
+{
+	uint64_t *in = malloc(sizeof(*in) * BATCH_CHECK);
+	struct timespec t0, t1;
+	factor_batch_t batch;
+	size_t i, bad = 0;
+	double ns;
+
+	if (!in)
+		return (-1);
+	for (i = 0; i < BATCH_CHECK; i++)
+		in[i] = rand_width();
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if (prime_factors_batch(in, BATCH_CHECK, &batch, nb_threads))
+	{
+		free(in);
+		return (-1);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+	for (i = 0; i < BATCH_CHECK; i++)
+	{
+		if (batch.offsets[i + 1] >= batch.offsets[i] &&
+			check_input(in[i], batch.values + batch.offsets[i],
+				batch.offsets[i + 1] - batch.offsets[i]))
+			continue;
+		if (bad++ < 5)
+			fprintf(stderr, "batch: wrong factors for %lu\n",
+				(unsigned long)in[i]);
+	}
+	bad += batch.offsets[BATCH_CHECK] != batch.nb_values;
+	printf("%-14s %12.0f ns/input  (%lu factors, %lu wrong)\n",
+		"batch", ns / BATCH_CHECK, (unsigned long)batch.nb_values,
+		(unsigned long)bad);
+	factor_batch_free(&batch);
+	free(in);
+	return (bad ? -1 : 0);
+}
+
+/**
+ * rand_prime - draws a random 21-bit prime
+ * Return: the prime
+ */
+static uint64_t rand_prime(void)
+{
+	uint64_t p;
+
+	do {
+		p = (rand() & ((1UL << 20) - 1)) | (1UL << 20) | 1;
+	} while (!is_prime_u64(p));
+	return (p);
+}
+
+/**
+ * check_parallel - factors products of three primes with
+ * prime_factors_parallel() and checks the factors found
+ * @nb_workers: threads per factorization
+ * Return: 0 if every product was factored, -1 otherwise
+ */
+static int check_parallel(size_t nb_workers)
+{
+	uint64_t p[3], t, product;
+	struct timespec t0, t1;
+	size_t i, bad = 0, ok;
+	list_t *factors;
+	node_t *node;
+	double ns = 0;
+	char s[24];
+
+	for (i = 0; i < PARALLEL_CHECK; i++)
+	{
+		p[0] = rand_prime(), p[1] = rand_prime(), p[2] = rand_prime();
+		sprintf(s, "%lu", (unsigned long)(p[0] * p[1] * p[2]));
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		factors = prime_factors_parallel(s, nb_workers);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		ns += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+		ok = factors && factors->size == 3;
+		for (node = factors ? factors->head : NULL, t = 0, product = 1;
+			ok && node; node = node->next)
+		{
+			ok = *(unsigned long *)node->content >= t;
+			t = *(unsigned long *)node->content;
+			product *= t;
+		}
+		if (!ok || product != p[0] * p[1] * p[2])
+			bad++;
+		if (factors)
+			list_destroy(factors, free);
+		free(factors);
+	}
+	printf("%-14s %12.0f ns/input  (%lu threads, %lu wrong)\n",
+		"parallel rho", ns / PARALLEL_CHECK, (unsigned long)nb_workers,
+		(unsigned long)bad);
+	return (bad ? -1 : 0);
+}
+
+/**
+ * main - Entry point
+ *
+ * @ac: Arguments count
+ * @av: Arguments vector
+ *
+ * Return: EXIT_SUCCESS upon success, EXIT_FAILURE otherwise
+ */
+int main(int ac, char **av)
+{
+	size_t i, n = ac > 1 ? strtoul(av[1], NULL, 10) : 500, count;
+	uint64_t *in = malloc(sizeof(*in) * (n ? n : 1));
+	double naive, table;
+
+	if (!in || !n)
+		return (EXIT_FAILURE);
+	srand(ac > 2 ? atoi(av[2]) : 42);
+	for (i = 0; i < n; i++)
+		in[i] = (((uint64_t)rand() << 31 | rand()) & ((1UL << 40) - 1))
+			| (1UL << 39);
+	prime_table(&count); /* Build the table outside of the timings */
+	printf("%lu random 40-bit inputs, %lu primes in table\n",
+		(unsigned long)n, (unsigned long)count);
+	naive = bench("naive loop", naive_divide, in, n);
+	table = bench("table + wheel", table_divide, in, n);
+	bench("pollard-rho", factor_u64, in, n);
+	printf("table + wheel speedup: %.2fx\n", naive / table);
+	free(in);
+	if (check_batch(4) | check_parallel(4))
+		return (EXIT_FAILURE);
+	return (EXIT_SUCCESS);
+}
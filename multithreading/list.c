@@ -41,6 +41,31 @@ node_t *list_add(list_t *list, void *content)
 	return (node);
 }
 
+/**
+ * list_shift - Removes the front node of a list
+ *
+ * @list: Pointer to the list to remove the node from
+ *
+ * Return: The content of the removed node, NULL if the list is empty
+ */
+void *list_shift(list_t *list)
+{
+	node_t *node = list->head;
+	void *content;
+
+	if (!node)
+		return (NULL);
+	list->head = node->next;
+	if (list->head)
+		list->head->prev = NULL;
+	else
+		list->tail = NULL;
+	--list->size;
+	content = node->content;
+	free(node);
+	return (content);
+}
+
 /**
  * list_init - Initializes a list structure
  *
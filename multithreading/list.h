@@ -36,6 +36,7 @@ typedef void (*node_func_t)(void *);
 /* list.c */
 node_t	*node_create(void *content);
 node_t	*list_add(list_t *list, void *content);
+void	*list_shift(list_t *list);
 list_t	*list_init(list_t *list);
 void	list_destroy(list_t *list, node_func_t free_func);
 void	list_each(list_t *list, node_func_t func);
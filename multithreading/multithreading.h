@@ -75,6 +75,206 @@ typedef struct blur_portion_s
 
 } blur_portion_t;
 
+__extension__ typedef unsigned __int128 uint128_t;
+
+/**
+* struct mont_s - Montgomery arithmetic context for an odd 64-bit modulus
+*
+* @n:   Modulus
+* @inv: n^-1 mod 2^64
+* @r2:  R^2 mod n, with R = 2^64
+* @one: 1 in Montgomery form (R mod n)
+*/
+typedef struct mont_s
+{
+	uint64_t n;
+	uint64_t inv;
+	uint64_t r2;
+	uint64_t one;
+} mont_t;
+
+#define MAX_FACTORS 64 /* A 64-bit number has at most 64 prime factors */
+#define TRIAL_DIVISION_LIMIT 1024 /* Factors below this use trial division */
+
+#ifndef PRIME_SIEVE_BOUND
+#define PRIME_SIEVE_BOUND (1UL << 20) /* Default size of the prime table */
+#endif
+
+/**
+* struct factor_batch_s - Prime factors of many numbers, in CSR layout
+*
+* @offsets:   n + 1 offsets; the factors of input i are
+*             values[offsets[i]] to values[offsets[i + 1] - 1]
+* @values:    Prime factors of every input, each run in ascending order
+* @nb_values: Total number of factors
+*/
+typedef struct factor_batch_s
+{
+	size_t *offsets;
+	uint64_t *values;
+	size_t nb_values;
+} factor_batch_t;
+
+/**
+* struct divisor_s - Small odd prime with its exact-division constants
+*
+* @p:   Prime
+* @inv: p^-1 mod 2^64, so that n / p == n * inv when p divides n
+* @lim: UINT64_MAX / p; p divides n iff n * inv <= lim
+*/
+typedef struct divisor_s
+{
+	uint64_t p;
+	uint64_t inv;
+	uint64_t lim;
+} divisor_t;
+
+/**
+* struct batch_chunk_s - Slice of a batch, factored by a single task
+*
+* @in:        First input of the slice
+* @n:         Number of inputs in the slice
+* @counts:    Where to store the number of factors of each input
+* @divs:      Odd primes below TRIAL_DIVISION_LIMIT
+* @nb_divs:   Number of divisors
+* @values:    Factors of the slice, grown as needed
+* @nb_values: Number of factors in values
+* @cap:       Capacity of values
+*/
+typedef struct batch_chunk_s
+{
+	uint64_t const *in;
+	size_t n;
+	size_t *counts;
+	divisor_t const *divs;
+	size_t nb_divs;
+	uint64_t *values;
+	size_t nb_values;
+	size_t cap;
+} batch_chunk_t;
+
+#ifndef FACTOR_CACHE_SHARDS
+#define FACTOR_CACHE_SHARDS 16 /* Independently locked parts, power of 2 */
+#endif
+#ifndef FACTOR_CACHE_SETS
+#define FACTOR_CACHE_SETS 256 /* Sets per shard, power of 2 */
+#endif
+#define FACTOR_CACHE_WAYS 8 /* Slots per set */
+#define FACTOR_CACHE_MAX_FACTORS 6 /* (2^10)^6 < 2^64 < (2^10)^7 */
+
+/**
+* struct factor_entry_s - Cached factorization of a cofactor
+*
+* @n:       Cofactor, 0 for an empty slot
+* @factors: Its prime factors
+* @count:   Number of factors
+* @ref:     CLOCK reference bit, set on every hit
+*/
+typedef struct factor_entry_s
+{
+	uint64_t n;
+	uint64_t factors[FACTOR_CACHE_MAX_FACTORS];
+	uint8_t count;
+	uint8_t ref;
+} factor_entry_t;
+
+/**
+* struct factor_set_s - Slots a given number may be stored in
+*
+* @ways: Slots
+* @hand: CLOCK hand, next slot considered for eviction
+*/
+typedef struct factor_set_s
+{
+	factor_entry_t ways[FACTOR_CACHE_WAYS];
+	size_t hand;
+} factor_set_t;
+
+/**
+* struct factor_cache_stats_s - Factor cache counters
+*
+* @hits:       Lookups that found the number
+* @misses:     Lookups that did not
+* @insertions: Numbers added
+* @evictions:  Numbers dropped to make room for another one
+*/
+typedef struct factor_cache_stats_s
+{
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long insertions;
+	unsigned long evictions;
+} factor_cache_stats_t;
+
+/**
+* struct factor_shard_s - Independently locked part of the factor cache
+*
+* @lock:  Shard mutex
+* @sets:  Sets of the shard
+* @stats: Shard counters
+*/
+typedef struct factor_shard_s
+{
+	pthread_mutex_t lock;
+	factor_set_t sets[FACTOR_CACHE_SETS];
+	factor_cache_stats_t stats;
+} factor_shard_t;
+
+/**
+* struct rho_race_s - Pollard-rho walks racing to split the same number
+*
+* @n:      Number to split
+* @factor: First non-trivial divisor found, 0 until then
+* @stop:   Set by the winner to cancel the other walks
+*/
+typedef struct rho_race_s
+{
+	uint64_t n;
+	uint64_t factor;
+	int stop;
+} rho_race_t;
+
+/**
+* struct rho_racer_s - One walk of a race
+*
+* @race:    Shared race
+* @c:       First walk constant to try
+* @stride:  Distance to the next constant to try, the number of racers
+*/
+typedef struct rho_racer_s
+{
+	rho_race_t *race;
+	uint64_t c;
+	uint64_t stride;
+} rho_racer_t;
+
+/**
+* struct rho_pool_s - Threads running the races of one factorization, with
+*                     the calling thread
+*
+* @lock:       Protects the fields below
+* @start:      Signaled when a race is posted or the pool stops
+* @done:       Signaled when a thread is done with the current race
+* @tasks:      Racer tasks of the current race
+* @race:       Number of races posted so far
+* @busy:       Threads still running the current race
+* @stopping:   Set to make the threads exit
+* @threads:    Pool threads
+* @nb_threads: Number of pool threads, the racers of a race being one more
+*/
+typedef struct rho_pool_s
+{
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	list_t const *tasks;
+	size_t race;
+	size_t busy;
+	int stopping;
+	pthread_t *threads;
+	size_t nb_threads;
+} rho_pool_t;
+
 typedef void *(*task_entry_t)(void *);
 
 /**
@@ -84,6 +284,8 @@ typedef void *(*task_entry_t)(void *);
 * @STARTED: Task has started
 * @SUCCESS: Task has completed successfully
 * @FAILURE: Task has completed with issues
+* @CANCELLED: Task was cancelled through its cancellation token
+* @TIMEOUT: Task reached its deadline
 */
 typedef enum task_status_e
 {
@@ -91,9 +293,114 @@ typedef enum task_status_e
 	STARTED,
 	SUCCESS,
 	FAILURE,
+	CANCELLED,
+	TIMEOUT,
 	TASK_STATUS_MAX /* Number of task statuses */
 } task_status_t;
 
+/**
+* enum task_priority_e - Task priority classes
+*
+* @TASK_PRIO_HIGH:   Latency-sensitive tasks, run first
+* @TASK_PRIO_NORMAL: Default class
+* @TASK_PRIO_LOW:    Bulk work
+*/
+typedef enum task_priority_e
+{
+	TASK_PRIO_HIGH = 0,
+	TASK_PRIO_NORMAL,
+	TASK_PRIO_LOW,
+	TASK_PRIO_MAX /* Number of priority classes */
+} task_priority_t;
+
+#ifndef TASK_AGING_NS
+#define TASK_AGING_NS 100000000UL /* A pending task gains a class per 100ms */
+#endif
+
+/**
+* struct task_prio_stats_s - Queue metrics of a priority class
+*
+* @depth:      Tasks of the class currently pending
+* @dispatched: Tasks of the class started so far
+* @wait_ns:    Total time those tasks spent pending, in nanoseconds
+* @max_wait_ns: Longest time one of them spent pending
+*/
+typedef struct task_prio_stats_s
+{
+	unsigned long depth;
+	unsigned long dispatched;
+	uint64_t wait_ns;
+	uint64_t max_wait_ns;
+} task_prio_stats_t;
+
+#define TASK_STATS_MAX_WORKERS 64 /* Live threads beyond this share a slot */
+#define TASK_HIST_SUB_BITS 3 /* 8 sub-buckets per power of two, 12.5% error */
+#define TASK_HIST_BUCKETS ((64 - TASK_HIST_SUB_BITS + 1) << TASK_HIST_SUB_BITS)
+
+/**
+* struct task_hist_s - Log-linear (HDR-style) histogram of durations
+*
+* @count:   Number of recorded durations
+* @buckets: Counts per bucket; see task_hist_floor() for the bucket bounds
+*/
+typedef struct task_hist_s
+{
+	unsigned long count;
+	unsigned long buckets[TASK_HIST_BUCKETS];
+} task_hist_t;
+
+/**
+* struct task_worker_stats_s - Counters of one thread running exec_tasks()
+*
+* @thread:       Thread
+* @tasks_run:    Tasks it ran
+* @steals:       Tasks it picked but another thread claimed first
+* @busy_ns:      Time spent running tasks
+* @idle_ns:      Time spent in exec_tasks() looking for a task
+* @lock_wait_ns: Time spent waiting for task locks
+* @queue_wait:   Time the tasks it ran spent pending
+* @run_time:     Time the tasks it ran took
+*/
+typedef struct task_worker_stats_s
+{
+	pthread_t thread;
+	unsigned long tasks_run;
+	unsigned long steals;
+	uint64_t busy_ns;
+	uint64_t idle_ns;
+	uint64_t lock_wait_ns;
+	task_hist_t queue_wait;
+	task_hist_t run_time;
+} task_worker_stats_t;
+
+/**
+* struct task_stats_s - Snapshot of the task system metrics
+*
+* @queue_wait: Queue wait times of all workers, retired ones included
+* @run_time:   Run times of all workers, retired ones included
+* @retired:    Counters of the workers that exited, merged
+* @nb_workers: Number of live workers
+* @workers:    Per-worker counters of the live workers
+*/
+typedef struct task_stats_s
+{
+	task_hist_t queue_wait;
+	task_hist_t run_time;
+	task_worker_stats_t retired;
+	size_t nb_workers;
+	task_worker_stats_t workers[];
+} task_stats_t;
+
+/**
+* struct cancel_token_s - Cancellation token, may be shared by many tasks
+*
+* @cancelled: Set once by cancel_token_cancel(), never cleared
+*/
+typedef struct cancel_token_s
+{
+	int cancelled;
+} cancel_token_t;
+
 /**
 * struct task_s - Executable task structure
 *
@@ -102,6 +409,13 @@ typedef enum task_status_e
 * @status: Task status, default to PENDING
 * @result: Stores the return value of the entry function
 * @lock:   Task mutex
+* @id:     Task number, in creation order
+* @flags:  TASK_* flags, 0 by default
+* @cancel: Cancellation token, NULL by default
+* @deadline: CLOCK_MONOTONIC time in ns after which the task times out,
+*           0 (no deadline) by default
+* @priority: Priority class, TASK_PRIO_NORMAL by default
+* @created: CLOCK_MONOTONIC creation time in ns, where waiting starts
 */
 typedef struct task_s
 {
@@ -113,19 +427,128 @@ typedef struct task_s
 
 	pthread_mutex_t lock;
 	unsigned int id;
+	unsigned int flags;
+	cancel_token_t *cancel;
+	uint64_t deadline;
+	task_priority_t priority;
+	uint64_t created;
 
 } task_t;
 
+#define TASK_QUIET 1 /* exec_tasks() does not log this task */
+
+#ifndef EXECUTOR_IDLE_NS
+#define EXECUTOR_IDLE_NS 100000000UL /* Workers idle for 100ms exit */
+#endif
+#ifndef EXECUTOR_SPAWN_NS
+#define EXECUTOR_SPAWN_NS 50000UL /* Backlog per worker worth a new thread */
+#endif
+
+typedef void (*task_consumer_t)(task_t *task, void *arg);
+
+/**
+* struct task_executor_s - Pool of workers that grows and shrinks with load
+*
+* @lock:        Protects every other field but wake, consume and the consumer
+* @done:        Signalled when unfinished or nb_workers drops to 0
+* @room:        Signalled when a task finishes, for submitters over window
+* @queues:      Pending tasks, one FIFO per priority class
+* @depth:       Number of tasks in the queues
+* @unfinished:  Tasks submitted but not finished yet
+* @wake:        Futex word idle workers park on, bumped to wake them
+* @nb_workers:  Workers alive
+* @nb_idle:     Workers parked
+* @max_workers: Upper bound on nb_workers, 0 to follow the CPU affinity
+* @avg_run_ns:  Moving average of the task run time
+* @stopping:    Set by task_executor_destroy()
+* @consumer:    Called with every finished task in streaming mode, or NULL
+* @consumer_arg: Second argument of the consumer
+* @consume:     Serializes the consumer calls
+* @window:      In streaming mode, most tasks submitted but not consumed yet
+*/
+typedef struct task_executor_s
+{
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+	pthread_cond_t room;
+	list_t queues[TASK_PRIO_MAX];
+	size_t depth;
+	size_t unfinished;
+	uint32_t wake;
+	size_t nb_workers;
+	size_t nb_idle;
+	size_t max_workers;
+	uint64_t avg_run_ns;
+	int stopping;
+	task_consumer_t consumer;
+	void *consumer_arg;
+	pthread_mutex_t consume;
+	size_t window;
+} task_executor_t;
+
 /*Functions prototypes*/
 void *thread_entry(void *arg);
 int tprintf(char const *format, ...);
 void blur_portion(blur_portion_t const *portion);
 void blur_image(img_t *img_blur, img_t const *img, kernel_t const *kernel);
 list_t *prime_factors(char const *s);
+void mont_init(mont_t *m, uint64_t n);
+uint64_t mont_mul(uint64_t a, uint64_t b, mont_t const *m);
+uint64_t mont_pow(uint64_t a, uint64_t e, mont_t const *m);
+int is_prime_u64(uint64_t n);
+uint64_t gcd_u64(uint64_t a, uint64_t b);
+uint64_t pollard_brent(uint64_t n, uint64_t c, int const *stop);
+size_t factor_u64(uint64_t n, uint64_t *factors);
+void split_factors(uint64_t n, uint64_t *factors, size_t *count);
+int factor_cache_get(uint64_t n, uint64_t *factors, size_t *count);
+void factor_cache_put(uint64_t n, uint64_t const *factors, size_t count);
+void factor_cache_stats(factor_cache_stats_t *stats);
+void factor_cofactor(uint64_t n, uint64_t *factors, size_t *count);
+size_t trial_divide(uint64_t *n, uint64_t limit, uint64_t *factors);
+uint32_t const *prime_table(size_t *count);
+uint64_t prime_sieve_bound(uint64_t bound);
+void wheel_divide(uint64_t *n, uint64_t from, uint64_t limit,
+	uint64_t *factors, size_t *count);
 task_t *create_task(task_entry_t entry, void *param);
 void destroy_task(task_t *task);
 void *exec_tasks(list_t const *tasks);
 task_status_t get_task_status(task_t *task);
 void set_task_status(task_t *task, task_status_t status);
 void *exec_task(task_t *task);
+int claim_task(task_t *task);
+uint64_t now_ns(void);
+void set_current_task(task_t *task);
+task_t *current_task(void);
+int task_should_stop(void);
+task_status_t task_stop_status(task_t const *task);
+void cancel_token_cancel(cancel_token_t *token);
+void set_task_cancel(task_t *task, cancel_token_t *token);
+void set_task_deadline(task_t *task, uint64_t timeout_ns);
+void set_task_priority(task_t *task, task_priority_t priority);
+task_t *pick_task(list_t const *tasks, node_t **cursors);
+long task_level(task_t const *task, uint64_t now);
+void task_queued(task_t const *task, long delta);
+void task_dispatched(task_t const *task);
+void task_priority_stats(task_priority_t priority, task_prio_stats_t *stats);
+task_worker_stats_t *task_worker(void);
+void task_hist_record(task_hist_t *hist, uint64_t ns);
+uint64_t task_hist_floor(size_t bucket);
+uint64_t task_hist_percentile(task_hist_t const *hist, double q);
+void task_lock(task_t *task);
+task_stats_t *task_stats_snapshot(void);
+void task_stats_dump(FILE *stream);
+int task_stats_dump_every(unsigned int seconds);
+void run_task(task_t *task);
+task_executor_t *task_executor_create(size_t max_workers);
+int task_executor_submit(task_executor_t *ex, task_t *task);
+void task_executor_wait(task_executor_t *ex);
+int task_executor_stream(task_executor_t *ex, task_consumer_t consumer,
+	void *arg, size_t window);
+void task_executor_destroy(task_executor_t *ex);
+int prime_factors_batch(uint64_t const *in, size_t n, factor_batch_t *out,
+	size_t nb_threads);
+void factor_batch_free(factor_batch_t *batch);
+list_t *prime_factors_parallel(char const *s, size_t nb_workers);
+void *rho_racer(rho_racer_t *racer);
+void *factor_chunk(batch_chunk_t *chunk);
 #endif /*MULTITHREADING_H*/
@@ -0,0 +1,165 @@
+#include "multithreading.h"
+#include "prime_factors_batch_helpers.c"
+#include <stdlib.h>
+#include <string.h>
+
+#define BATCH_CHUNK 1024 /* Inputs factored by a single task */
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/**
+ * divisors_init - computes the exact-division constants of the odd primes
+ *                 below TRIAL_DIVISION_LIMIT
+ * @divs: output array, holding at least TRIAL_DIVISION_LIMIT / 2 elements
+ * Return: number of divisors
+ */
+static size_t divisors_init(divisor_t *divs)
+{
+	size_t nb_primes, i, n = 0;
+	uint32_t const *primes = prime_table(&nb_primes);
+	uint64_t p = 1, from = 1;
+	int k;
+
+	/* The table is sorted: the primes past the limit are never used */
+	for (i = 1; primes && i < nb_primes &&
+		primes[i] < TRIAL_DIVISION_LIMIT; i++)
+		divs[n++].p = primes[i], from = primes[i];
+	for (p = from + 2; p < TRIAL_DIVISION_LIMIT; p += 2) /* Tiny table */
+		if (is_prime_u64(p))
+			divs[n++].p = p;
+	for (i = 0; i < n; i++)
+	{
+		p = divs[i].p;
+		for (divs[i].inv = p, k = 0; k < 5; k++)
+			divs[i].inv *= 2 - p * divs[i].inv;
+		divs[i].lim = UINT64_MAX / p;
+	}
+	return (n);
+}
+
+/**
+ * batch_collect - gathers the factors of every chunk into the CSR output
+ * @tasks: executed tasks, one per chunk
+ * @n: number of inputs
+ * @out: batch output; counts are already stored in out->offsets[1..n]
+ * Return: 0 on success, -1 if a chunk failed or on allocation failure
+ */
+static int batch_collect(list_t *tasks, size_t n, factor_batch_t *out)
+{
+	batch_chunk_t *chunk;
+	task_t *task;
+	node_t *node;
+	size_t i;
+	int ok = 1;
+
+	for (i = 0; i < n; i++)
+		out->offsets[i + 1] += out->offsets[i];
+	out->nb_values = out->offsets[n];
+	out->values = malloc(sizeof(*out->values) * (out->nb_values + 1));
+	ok = out->values != NULL;
+	for (node = tasks->head; node; node = node->next)
+	{
+		task = node->content;
+		chunk = task->param;
+		ok = ok && task->status == SUCCESS;
+		if (ok) /* counts[-1] now holds the offset of the chunk */
+			memcpy(out->values + chunk->counts[-1], chunk->values,
+				sizeof(*chunk->values) * chunk->nb_values);
+		free(chunk->values);
+		task->result = NULL; /* Owned by the chunk, not a list_t */
+	}
+	return (ok ? 0 : -1);
+}
+
+/**
+ * batch_tasks - creates one quiet task per chunk of inputs
+ * @in: numbers to factor
+ * @n: number of inputs
+ * @chunks: chunks to fill, one per BATCH_CHUNK inputs
+ * @counts: where chunks store the number of factors of each input
+ * @divs: divisors shared by every chunk, initialized here
+ * @tasks: list to add the tasks to
+ * Return: 1 on success, 0 on allocation failure
+ */
+static int batch_tasks(uint64_t const *in, size_t n, batch_chunk_t *chunks,
+	size_t *counts, divisor_t *divs, list_t *tasks)
+{
+	size_t nb_divs = divisors_init(divs), i;
+	batch_chunk_t *chunk;
+	task_t *task;
+
+	for (i = 0; i < n; i += BATCH_CHUNK)
+	{
+		chunk = chunks + i / BATCH_CHUNK;
+		chunk->in = in + i;
+		chunk->n = MIN(BATCH_CHUNK, n - i);
+		chunk->counts = counts + i;
+		chunk->divs = divs;
+		chunk->nb_divs = nb_divs;
+		task = create_task((task_entry_t)factor_chunk, chunk);
+		if (!task || !list_add(tasks, task))
+		{
+			destroy_task(task);
+			return (0);
+		}
+		task->flags |= TASK_QUIET;
+	}
+	return (1);
+}
+
+/**
+ * prime_factors_batch - factors many numbers at once
+ * The inputs are split into chunks, each chunk is a task of the task system
+ * run by nb_threads threads, the calling thread included.
+ * @in: numbers to factor
+ * @n: number of inputs
+ * @out: factors of every input, release with factor_batch_free()
+ * @nb_threads: number of threads to use
+ * Return: 0 on success, -1 on failure
+ */
+int prime_factors_batch(uint64_t const *in, size_t n, factor_batch_t *out,
+	size_t nb_threads)
+{
+	batch_chunk_t *chunks = calloc(n / BATCH_CHUNK + 1, sizeof(*chunks));
+	pthread_t *threads = malloc(sizeof(*threads) * (nb_threads + 1));
+	divisor_t *divs = malloc(sizeof(*divs) * (TRIAL_DIVISION_LIMIT / 2));
+	int ret = -1;
+	list_t tasks;
+	size_t i;
+
+	out->offsets = calloc(n + 1, sizeof(*out->offsets));
+	out->values = NULL;
+	list_init(&tasks);
+	if (chunks && threads && divs && out->offsets &&
+		batch_tasks(in, n, chunks, out->offsets + 1, divs, &tasks))
+	{
+		for (i = 1; i < nb_threads; i++)
+			if (pthread_create(threads + i, NULL,
+				(void *(*)(void *))exec_tasks, &tasks))
+				break;
+		nb_threads = i;
+		exec_tasks(&tasks);
+		for (i = 1; i < nb_threads; i++)
+			pthread_join(threads[i], NULL);
+		ret = batch_collect(&tasks, n, out);
+	}
+	list_destroy(&tasks, (node_func_t)destroy_task);
+	free(divs);
+	free(chunks);
+	free(threads);
+	if (ret)
+		factor_batch_free(out);
+	return (ret);
+}
+
+/**
+ * factor_batch_free - releases the arrays of a batch output
+ * @batch: batch output
+ */
+void factor_batch_free(factor_batch_t *batch)
+{
+	free(batch->offsets);
+	free(batch->values);
+	batch->offsets = NULL;
+	batch->values = NULL;
+	batch->nb_values = 0;
+}
@@ -0,0 +1,162 @@
+#include "multithreading.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Trial division of LANES inputs at a time: every input of a block is tested
+ * against the same prime with one vector multiply and compare, using the
+ * exact-division trick (n * p^-1 mod 2^64 <= UINT64_MAX / p iff p | n).
+ */
+
+#define LANES 4
+
+typedef uint64_t lanes_t __attribute__((vector_size(LANES * sizeof(uint64_t))));
+
+/**
+ * struct lane_factors_s - Factors found for each input of a block
+ *
+ * @f: factors, per lane
+ * @n: number of factors, per lane
+ */
+typedef struct lane_factors_s
+{
+	uint64_t f[LANES][MAX_FACTORS];
+	size_t n[LANES];
+} lane_factors_t;
+
+/**
+ * lanes_divide - divides every lane by a prime as many times as possible
+ * @x: lanes, updated in place
+ * @d: divisor
+ * @out: factors found so far
+ */
+static void lanes_divide(lanes_t *x, divisor_t const *d, lane_factors_t *out)
+{
+	lanes_t q = *x * d->inv, m = (lanes_t)(q <= d->lim);
+	size_t i;
+
+	while (m[0] | m[1] | m[2] | m[3])
+	{
+		for (i = 0; i < LANES; i++)
+			if (m[i])
+				out->f[i][out->n[i]++] = d->p;
+		*x = (q & m) | (*x & ~m);
+		q = *x * d->inv;
+		m = (lanes_t)(q <= d->lim);
+	}
+}
+
+/**
+ * sort_tail - sorts the factors of the cofactor, which come unordered after
+ * the ascending ones found by trial division
+ * @f: factors
+ * @from: first unordered factor
+ * @n: number of factors
+ */
+static void sort_tail(uint64_t *f, size_t from, size_t n)
+{
+	size_t i, j;
+	uint64_t tmp;
+
+	for (i = from + 1; i < n; i++)
+	{
+		for (j = i, tmp = f[i]; j > from && f[j - 1] > tmp; j--)
+			f[j] = f[j - 1];
+		f[j] = tmp;
+	}
+}
+
+/**
+ * factor_block - factors LANES inputs
+ * @in: inputs, unused lanes hold 1
+ * @divs: odd primes below TRIAL_DIVISION_LIMIT
+ * @nb_divs: number of divisors
+ * @out: factors of each input, in ascending order
+ */
+static void factor_block(uint64_t const *in, divisor_t const *divs,
+	size_t nb_divs, lane_factors_t *out)
+{
+	lanes_t x;
+	uint64_t max = 0;
+	size_t i, j, from;
+
+	for (i = 0; i < LANES; i++)
+	{
+		x[i] = in[i] < 2 ? 1 : in[i];
+		for (out->n[i] = 0; !(x[i] & 1); x[i] >>= 1)
+			out->f[i][out->n[i]++] = 2;
+		max = x[i] > max ? x[i] : max;
+	}
+	for (j = 0; j < nb_divs && divs[j].p * divs[j].p <= max; j++)
+		lanes_divide(&x, divs + j, out);
+	for (i = 0; i < LANES; i++)
+	{
+		if (x[i] < 2)
+			continue;
+		/* Stopping early: every lane is below the next prime squared */
+		if (j < nb_divs ||
+			x[i] / TRIAL_DIVISION_LIMIT < TRIAL_DIVISION_LIMIT)
+		{
+			out->f[i][out->n[i]++] = x[i];
+			continue;
+		}
+		from = out->n[i];
+		factor_cofactor(x[i], out->f[i], out->n + i);
+		sort_tail(out->f[i], from, out->n[i]);
+	}
+}
+
+/**
+ * chunk_append - appends the factors of one input to a chunk
+ * @chunk: chunk
+ * @f: factors
+ * @n: number of factors
+ * Return: 1 on success, 0 on allocation failure
+ */
+static int chunk_append(batch_chunk_t *chunk, uint64_t const *f, size_t n)
+{
+	uint64_t *tmp;
+
+	if (!n)
+		return (1);
+	if (chunk->nb_values + n > chunk->cap)
+	{
+		chunk->cap = (chunk->cap + n) * 2;
+		tmp = realloc(chunk->values, sizeof(*tmp) * chunk->cap);
+		if (!tmp)
+			return (0);
+		chunk->values = tmp;
+	}
+	memcpy(chunk->values + chunk->nb_values, f, sizeof(*f) * n);
+	chunk->nb_values += n;
+	return (1);
+}
+
+/**
+ * factor_chunk - task entry factoring a slice of a batch
+ * @chunk: slice to factor
+ * Return: the chunk on success, NULL on allocation failure or when the task
+ *         should stop
+ */
+void *factor_chunk(batch_chunk_t *chunk)
+{
+	uint64_t block[LANES];
+	lane_factors_t out;
+	size_t i, j;
+
+	for (i = 0; i < chunk->n; i += LANES)
+	{
+		if (task_should_stop())
+			return (NULL);
+		for (j = 0; j < LANES; j++)
+			block[j] = i + j < chunk->n ? chunk->in[i + j] : 1;
+		factor_block(block, chunk->divs, chunk->nb_divs, &out);
+		for (j = 0; j < LANES && i + j < chunk->n; j++)
+		{
+			chunk->counts[i + j] = out.n[j];
+			if (!chunk_append(chunk, out.f[j], out.n[j]))
+				return (NULL);
+		}
+	}
+	return (chunk);
+}
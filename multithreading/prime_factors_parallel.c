@@ -0,0 +1,244 @@
+#include "multithreading.h"
+#include <stdlib.h>
+
+/*
+ * Cooperative factorization of a single number: every hard cofactor is
+ * attacked by nb_workers Pollard-rho walks with different constants, each one
+ * a quiet task of the task system. The first walk to find a divisor cancels
+ * the others. The walks inherit the cancellation token and deadline of the
+ * task calling prime_factors_parallel(), if any. The threads running them are
+ * created once per call and reused by every split.
+ */
+
+/**
+ * rho_racer - task entry running walks until one of the race finds a divisor
+ * @racer: walk description
+ * Return: the racer
+ */
+void *rho_racer(rho_racer_t *racer)
+{
+	rho_race_t *race = racer->race;
+	uint64_t c, d, none = 0;
+
+	for (c = racer->c; !__atomic_load_n(&race->stop, __ATOMIC_ACQUIRE) &&
+		!task_should_stop(); c += racer->stride)
+	{
+		d = pollard_brent(race->n, c, &race->stop);
+		if (d == race->n)
+			continue;
+		__atomic_compare_exchange_n(&race->factor, &none, d, 0,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED);
+		__atomic_store_n(&race->stop, 1, __ATOMIC_RELEASE);
+	}
+	return (racer);
+}
+
+/**
+ * rho_pool_worker - thread entry running the racers of every posted race
+ * @pool: pool
+ * Return: NULL
+ */
+static void *rho_pool_worker(rho_pool_t *pool)
+{
+	size_t seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	while (1)
+	{
+		while (!pool->stopping && pool->race == seen)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->stopping)
+			break;
+		seen = pool->race;
+		pthread_mutex_unlock(&pool->lock);
+		exec_tasks(pool->tasks);
+		pthread_mutex_lock(&pool->lock);
+		if (!--pool->busy)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return (NULL);
+}
+
+/**
+ * rho_pool_init - starts the threads of a pool
+ * @pool: pool to initialize
+ * @nb_threads: number of threads to start, fewer if creating one fails
+ */
+static void rho_pool_init(rho_pool_t *pool, size_t nb_threads)
+{
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	pool->tasks = NULL;
+	pool->race = pool->busy = 0;
+	pool->stopping = 0;
+	pool->threads = malloc(sizeof(*pool->threads) * nb_threads);
+	for (pool->nb_threads = 0; pool->threads &&
+		pool->nb_threads < nb_threads; pool->nb_threads++)
+		if (pthread_create(pool->threads + pool->nb_threads, NULL,
+			(void *(*)(void *))rho_pool_worker, pool))
+			break;
+}
+
+/**
+ * rho_pool_destroy - stops the threads of a pool and releases it
+ * @pool: pool, without a race running
+ */
+static void rho_pool_destroy(rho_pool_t *pool)
+{
+	size_t i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stopping = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 0; i < pool->nb_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+	free(pool->threads);
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+}
+
+/**
+ * race_split - finds a divisor of a composite with concurrent walks
+ * @n: odd composite number without small factors
+ * @pool: threads running the walks, one walk each, with the calling thread
+ * Return: a non-trivial divisor of n, 0 on allocation failure or when the
+ *         calling task should stop
+ */
+static uint64_t race_split(uint64_t n, rho_pool_t *pool)
+{
+	size_t nb_workers = pool->nb_threads + 1, i;
+	task_t *parent = current_task();
+	rho_racer_t *racers = malloc(sizeof(*racers) * nb_workers);
+	rho_race_t race = {0, 0, 0};
+	task_t *task;
+	node_t *node;
+	list_t tasks;
+
+	race.n = n;
+	list_init(&tasks);
+	for (i = 0; racers && i < nb_workers; i++)
+	{
+		racers[i].race = &race;
+		racers[i].c = i + 1;
+		racers[i].stride = nb_workers;
+		task = create_task((task_entry_t)rho_racer, racers + i);
+		if (!task || !list_add(&tasks, task))
+		{
+			destroy_task(task);
+			break;
+		}
+		task->flags |= TASK_QUIET;
+		if (parent)
+		{
+			task->cancel = parent->cancel;
+			task->deadline = parent->deadline;
+		}
+	}
+	pthread_mutex_lock(&pool->lock);
+	pool->tasks = &tasks;
+	pool->busy = pool->nb_threads;
+	pool->race++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	exec_tasks(&tasks);
+	pthread_mutex_lock(&pool->lock);
+	while (pool->busy)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+	for (node = tasks.head; node; node = node->next)
+		((task_t *)node->content)->result = NULL; /* Not a list_t */
+	list_destroy(&tasks, (node_func_t)destroy_task);
+	free(racers);
+	return (race.factor);
+}
+
+/**
+ * split_parallel - recursively splits n into prime factors
+ * @n: number without factors below TRIAL_DIVISION_LIMIT
+ * @factors: output array, factors are appended to it, unordered
+ * @count: number of factors already in the array
+ * @pool: threads running the walks of every split
+ * Return: 1 on success, 0 on allocation failure or when the calling task
+ *         should stop
+ */
+static int split_parallel(uint64_t n, uint64_t *factors, size_t *count,
+	rho_pool_t *pool)
+{
+	size_t from = *count;
+	uint64_t d;
+
+	if (n == 1 || factor_cache_get(n, factors, count))
+		return (1);
+	if (is_prime_u64(n))
+	{
+		factors[(*count)++] = n;
+		return (1);
+	}
+	d = race_split(n, pool);
+	if (!d || !split_parallel(d, factors, count, pool) ||
+		!split_parallel(n / d, factors, count, pool))
+		return (0);
+	factor_cache_put(n, factors + from, *count - from);
+	return (1);
+}
+
+/**
+ * factors_to_list - sorts factors and stores them in a list
+ * @factors: factors
+ * @count: number of factors
+ * Return: list_t of factors, in ascending order, NULL on failure
+ */
+static list_t *factors_to_list(uint64_t *factors, size_t count)
+{
+	list_t *list = malloc(sizeof(list_t));
+	unsigned long *tmp;
+	size_t i, j;
+	uint64_t f;
+
+	if (!list)
+		return (NULL);
+	for (i = 1; i < count; i++)
+	{
+		for (j = i, f = factors[i]; j && factors[j - 1] > f; j--)
+			factors[j] = factors[j - 1];
+		factors[j] = f;
+	}
+	list_init(list);
+	for (i = 0; i < count; i++)
+	{
+		tmp = malloc(sizeof(unsigned long));
+		*tmp = factors[i];
+		list_add(list, (void *)tmp);
+	}
+	return (list);
+}
+
+/**
+ * prime_factors_parallel - factors a number into a list of prime factors,
+ *                          spreading the work over several threads
+ * @s: string representation of the number to factor
+ * @nb_workers: number of threads, the calling thread included
+ * Return: list_t of prime factors, in ascending order, NULL on failure or
+ *         if the task running it was cancelled or timed out
+ */
+list_t *prime_factors_parallel(char const *s, size_t nb_workers)
+{
+	uint64_t n = strtoul(s, NULL, 10), factors[MAX_FACTORS];
+	size_t count = trial_divide(&n, TRIAL_DIVISION_LIMIT, factors);
+	rho_pool_t pool;
+	int ok = 1;
+
+	if (n >= 2 && n / TRIAL_DIVISION_LIMIT < TRIAL_DIVISION_LIMIT)
+		factors[count++] = n;
+	else if (n >= 2)
+	{
+		rho_pool_init(&pool, nb_workers ? nb_workers - 1 : 0);
+		ok = split_parallel(n, factors, &count, &pool);
+		rho_pool_destroy(&pool);
+	}
+	return (ok ? factors_to_list(factors, count) : NULL);
+}
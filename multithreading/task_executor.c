@@ -0,0 +1,329 @@
+#define _GNU_SOURCE /* sched_getaffinity, syscall */
+#include "multithreading.h"
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Executor running submitted tasks on a pool of detached workers sized by
+ * load. A worker is spawned when the queued work, estimated from the moving
+ * average of the task run time, would keep every current worker busy for
+ * more than EXECUTOR_SPAWN_NS, or when the oldest queued task has already
+ * waited that long, up to the number of CPUs the process may run on. Idle
+ * workers park on a futex and exit after EXECUTOR_IDLE_NS without work, so a
+ * quiet executor holds no thread at all.
+ * In streaming mode the executor owns the submitted tasks: each one is handed
+ * to the consumer as soon as it finishes, then destroyed, so memory stays
+ * bounded by the window whatever the number of tasks.
+ */
+
+/**
+ * executor_cpus - counts the CPUs the process may run on
+ * Return: the number of CPUs in its affinity mask, at least 1
+ */
+static size_t executor_cpus(void)
+{
+	cpu_set_t set;
+	long n;
+
+	if (!sched_getaffinity(0, sizeof(set), &set))
+		return (CPU_COUNT(&set));
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0 ? (size_t)n : 1);
+}
+
+/**
+ * executor_next - dequeues the task that should run next
+ * Queues are FIFO, so the head of each holds the oldest task of its class
+ * and the best effective class is found among the heads only.
+ * @ex: executor, locked
+ * Return: the task, NULL if no task is queued
+ */
+static task_t *executor_next(task_executor_t *ex)
+{
+	uint64_t now = now_ns();
+	long level, best_level = TASK_PRIO_MAX;
+	size_t i, best = 0;
+
+	for (i = 0; i < TASK_PRIO_MAX && best_level; i++)
+	{
+		if (!ex->queues[i].head)
+			continue;
+		level = task_level(ex->queues[i].head->content, now);
+		if (level < best_level)
+			best = i, best_level = level;
+	}
+	if (best_level == TASK_PRIO_MAX)
+		return (NULL);
+	ex->depth--;
+	return (list_shift(ex->queues + best));
+}
+
+/**
+ * executor_oldest - gets the creation time of the oldest queued task
+ * @ex: executor, locked
+ * Return: the time, from now_ns(), or UINT64_MAX if no task is queued
+ */
+static uint64_t executor_oldest(task_executor_t const *ex)
+{
+	uint64_t oldest = UINT64_MAX;
+	task_t const *task;
+	size_t i;
+
+	for (i = 0; i < TASK_PRIO_MAX; i++)
+	{
+		if (!ex->queues[i].head)
+			continue;
+		task = ex->queues[i].head->content;
+		oldest = task->created < oldest ? task->created : oldest;
+	}
+	return (oldest);
+}
+
+/**
+ * executor_park - puts the calling worker to sleep until work is submitted
+ * @ex: executor, locked; unlocked while sleeping
+ * Return: 1 if the worker slept for EXECUTOR_IDLE_NS without being woken
+ */
+static int executor_park(task_executor_t *ex)
+{
+	struct timespec timeout = {EXECUTOR_IDLE_NS / 1000000000UL,
+		EXECUTOR_IDLE_NS % 1000000000UL};
+	uint32_t seq = ex->wake;
+	uint64_t start = now_ns();
+	long ret;
+
+	ex->nb_idle++;
+	pthread_mutex_unlock(&ex->lock);
+	ret = syscall(SYS_futex, &ex->wake, FUTEX_WAIT_PRIVATE, seq, &timeout,
+		NULL, 0);
+	ret = ret == -1 && errno == ETIMEDOUT;
+	__atomic_add_fetch(&task_worker()->idle_ns, now_ns() - start,
+		__ATOMIC_RELAXED);
+	pthread_mutex_lock(&ex->lock);
+	ex->nb_idle--;
+	return (ret);
+}
+
+/**
+ * executor_wake - wakes parked workers
+ * @ex: executor, locked
+ * @count: number of workers to wake, INT_MAX for all of them
+ */
+static void executor_wake(task_executor_t *ex, int count)
+{
+	ex->wake++;
+	syscall(SYS_futex, &ex->wake, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+static void *executor_worker(task_executor_t *ex);
+
+/**
+ * executor_consume - hands a finished task to the consumer and destroys it
+ * Consumer calls never overlap, and come in completion order.
+ * @ex: executor, unlocked
+ * @task: finished task
+ */
+static void executor_consume(task_executor_t *ex, task_t *task)
+{
+	pthread_mutex_lock(&ex->consume);
+	ex->consumer(task, ex->consumer_arg);
+	pthread_mutex_unlock(&ex->consume);
+	destroy_task(task);
+}
+
+/**
+ * executor_grow - spawns a worker if the queued work is worth one
+ * @ex: executor, locked; unlocked while the thread is created
+ */
+static void executor_grow(task_executor_t *ex)
+{
+	size_t max = ex->max_workers ? ex->max_workers : executor_cpus();
+	size_t backlog = ex->depth > ex->nb_idle ? ex->depth - ex->nb_idle : 0;
+	pthread_attr_t attr;
+	pthread_t thread;
+	int err;
+
+	if (!backlog || ex->nb_workers >= max || ex->stopping)
+		return;
+	if (ex->nb_workers &&
+		backlog * ex->avg_run_ns < EXECUTOR_SPAWN_NS * ex->nb_workers &&
+		now_ns() - executor_oldest(ex) < EXECUTOR_SPAWN_NS)
+		return;
+	ex->nb_workers++;
+	pthread_mutex_unlock(&ex->lock);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	err = pthread_create(&thread, &attr, (void *(*)(void *))executor_worker,
+		ex);
+	pthread_attr_destroy(&attr);
+	pthread_mutex_lock(&ex->lock);
+	if (err && !--ex->nb_workers)
+		pthread_cond_broadcast(&ex->done);
+}
+
+/**
+ * executor_worker - thread entry running queued tasks until idle for too long
+ * @ex: executor
+ * Return: NULL
+ */
+static void *executor_worker(task_executor_t *ex)
+{
+	int timed_out = 0, streaming;
+	uint64_t start;
+	task_t *task;
+
+	pthread_mutex_lock(&ex->lock);
+	while (!ex->stopping)
+	{
+		task = executor_next(ex);
+		if (!task)
+		{
+			if (timed_out)
+				break;
+			timed_out = executor_park(ex);
+			continue;
+		}
+		timed_out = 0;
+		streaming = ex->consumer != NULL;
+		pthread_mutex_unlock(&ex->lock);
+		start = now_ns();
+		if (claim_task(task))
+			run_task(task);
+		start = now_ns() - start;
+		if (streaming)
+			executor_consume(ex, task);
+		pthread_mutex_lock(&ex->lock);
+		ex->avg_run_ns += start / 8 - ex->avg_run_ns / 8;
+		if (!--ex->unfinished)
+			pthread_cond_broadcast(&ex->done);
+		pthread_cond_signal(&ex->room);
+		executor_grow(ex);
+	}
+	if (!--ex->nb_workers)
+		pthread_cond_broadcast(&ex->done);
+	pthread_mutex_unlock(&ex->lock);
+	return (NULL);
+}
+
+/**
+ * task_executor_create - creates an executor without any worker
+ * @max_workers: upper bound on the number of workers, 0 for the number of
+ *               CPUs the process may run on, checked every time one is added
+ * Return: the executor, NULL on failure
+ */
+task_executor_t *task_executor_create(size_t max_workers)
+{
+	task_executor_t *ex = calloc(1, sizeof(*ex));
+	size_t i;
+
+	if (!ex)
+		return (NULL);
+	pthread_mutex_init(&ex->lock, NULL);
+	pthread_mutex_init(&ex->consume, NULL);
+	pthread_cond_init(&ex->done, NULL);
+	pthread_cond_init(&ex->room, NULL);
+	for (i = 0; i < TASK_PRIO_MAX; i++)
+		list_init(ex->queues + i);
+	ex->max_workers = max_workers;
+	return (ex);
+}
+
+/**
+ * task_executor_submit - queues a task, waking or spawning a worker for it
+ * The task stays owned by the caller, who may destroy it once
+ * task_executor_wait() returns, unless the executor streams its results.
+ * Its priority must be set beforehand. In streaming mode, blocks while the
+ * window is full, so it must not be called from a task of the executor.
+ * @ex: executor
+ * @task: pending task
+ * Return: 0 on success, -1 if the executor is being destroyed or on
+ *         allocation failure, the task being left to the caller
+ */
+int task_executor_submit(task_executor_t *ex, task_t *task)
+{
+	pthread_mutex_lock(&ex->lock);
+	while (!ex->stopping && ex->window && ex->unfinished >= ex->window)
+		pthread_cond_wait(&ex->room, &ex->lock);
+	if (ex->stopping || !list_add(ex->queues + task->priority, task))
+	{
+		pthread_mutex_unlock(&ex->lock);
+		return (-1);
+	}
+	ex->depth++;
+	ex->unfinished++;
+	if (ex->nb_idle)
+		executor_wake(ex, 1);
+	executor_grow(ex);
+	pthread_mutex_unlock(&ex->lock);
+	return (0);
+}
+
+/**
+ * task_executor_stream - switches an idle executor to streaming mode
+ * Every task submitted from now on is owned by the executor. Once finished,
+ * it is passed to the consumer, then destroyed with destroy_task(): the
+ * consumer must take over and clear task->result if it is not a list_t of
+ * malloc'd values.
+ * @ex: executor, without unfinished tasks
+ * @consumer: function called with each finished task, NULL to stop streaming
+ * @arg: second argument of the consumer
+ * @window: most tasks submitted but not consumed yet, 0 for no limit
+ * Return: 0 on success, -1 if tasks are still running
+ */
+int task_executor_stream(task_executor_t *ex, task_consumer_t consumer,
+	void *arg, size_t window)
+{
+	int ret = -1;
+
+	pthread_mutex_lock(&ex->lock);
+	if (!ex->unfinished)
+	{
+		ex->consumer = consumer;
+		ex->consumer_arg = arg;
+		ex->window = consumer ? window : 0;
+		ret = 0;
+	}
+	pthread_mutex_unlock(&ex->lock);
+	return (ret);
+}
+
+/**
+ * task_executor_wait - waits for every submitted task to finish
+ * @ex: executor
+ */
+void task_executor_wait(task_executor_t *ex)
+{
+	pthread_mutex_lock(&ex->lock);
+	while (ex->unfinished)
+		pthread_cond_wait(&ex->done, &ex->lock);
+	pthread_mutex_unlock(&ex->lock);
+}
+
+/**
+ * task_executor_destroy - waits for the submitted tasks, stops the workers
+ * and releases the executor
+ * @ex: executor, may be NULL
+ */
+void task_executor_destroy(task_executor_t *ex)
+{
+	if (!ex)
+		return;
+	task_executor_wait(ex);
+	pthread_mutex_lock(&ex->lock);
+	ex->stopping = 1;
+	executor_wake(ex, INT_MAX);
+	pthread_cond_broadcast(&ex->room);
+	while (ex->nb_workers)
+		pthread_cond_wait(&ex->done, &ex->lock);
+	pthread_mutex_unlock(&ex->lock);
+	pthread_cond_destroy(&ex->done);
+	pthread_cond_destroy(&ex->room);
+	pthread_mutex_destroy(&ex->consume);
+	pthread_mutex_destroy(&ex->lock);
+	free(ex);
+}
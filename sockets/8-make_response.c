@@ -4,9 +4,12 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "http_request_parser.c"
 #include "http_request_utils.c"
 #include "todos.c"
+#include "todo_log.c"
+#include "http_response.c"
 
 #ifdef TODO_API_5
 #define GET_URIS     {"/todos"}
@@ -24,6 +27,10 @@
 #define DELETE_URIS  {NULL}
 #endif
 
+#ifndef TODO_STREAM_MIN
+#define TODO_STREAM_MIN 1048576 /* List size from which it is streamed */
+#endif
+
 #define CONNECT_URIS {NULL}
 #define OPTIONS_URIS {NULL}
 #define TRACE_URIS   {NULL}
@@ -46,176 +53,384 @@ int known_uri(http_request_t *request)
 		OPTIONS_URIS,
 		TRACE_URIS
 	};
-	char **uris = uris_by_method[request->method];
+	char **uris;
 	size_t i;
 
+	if (request->method == UNKNOWN)
+		return (false);
+	uris = uris_by_method[request->method];
 	for (i = 0; uris[i]; i++)
-		if (!strcmp(request->uri, uris[i]))
+		if (http_slice_is(request, request->uri, uris[i]))
 			return (true);
 
 	return (false);
 }
 
+static pthread_rwlock_t todos_lock = PTHREAD_RWLOCK_INITIALIZER;
+static todo_store_t todos;
+static todo_log_t todos_log;
+
 /**
- * process_get_request - processes a get request
+ * load_todos - loads the todo store from its snapshot and log, once
+ */
+static void load_todos(void)
+{
+	if (todo_log_open(&todos_log, &todos, &todos_lock) == -1)
+		perror("Todo log, changes will not be persisted");
+}
+
+/**
+ * release_json - releases a JSON snapshot, as response_own expects it
+ * @json: snapshot
+ */
+static void release_json(void *json)
+{
+	todo_json_release(json);
+}
+
+/**
+ * respond_todo - sets a todo as the body of a response
+ * The todo is copied: the store may change as soon as it is unlocked.
+ * @res: response, with its status line
+ * @todo: todo
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int respond_todo(response_t *res, todo_t const *todo)
+{
+	char *body = malloc(todo->repr_len);
+
+	if (!body)
+		return (-1);
+	memcpy(body, todo->repr, todo->repr_len);
+	response_body(res, "application/json", body, todo->repr_len);
+	response_own(res, body, free);
+	return (0);
+}
+
+/**
+ * respond_page - sets a page of the list of todos as the body of a response
+ * The page starts at the todo of id cursor, or the next one if it was
+ * deleted; the X-Next-Cursor header gives the cursor of the next page, and
+ * is left out on the last one.
  * @request: pointer to struct describing request
- * @body: pointer to response buffer
- * @todos: list of todos
- * @sum_repr_lens: length of the sum of all representations
- * @id: max id
- * Return: size of response
+ * @todos: todo store, read-locked
+ * @limit: limit parameter, NULL for TODO_PAGE_DEFAULT todos
+ * @cursor: cursor parameter, NULL to start at the first todo
+ * @res: response, with its status line
+ * Return: 0 on success, -1 on allocation failure
  */
-size_t process_get_request(http_request_t *request, char **body, todo_t *todos,
-int sum_repr_lens, int id)
+static int respond_page(http_request_t *request, todo_store_t *todos,
+	http_slice_t const *limit, http_slice_t const *cursor, response_t *res)
 {
-	char *delim, *tmp = get_param(request->query_params, "id");
-	size_t length;
-	int i;
+	long n = limit ? atol(request->raw + limit->off) : TODO_PAGE_DEFAULT;
+	char *body, next_cursor[16];
+	size_t len;
+	int next;
 
-	if (tmp)
+	n = n < 1 ? 1 : n > TODO_PAGE_MAX ? TODO_PAGE_MAX : n;
+	body = todo_store_page(todos, cursor ? atoi(request->raw + cursor->off)
+		: 0, n, &len, &next);
+	if (!body)
+		return (-1);
+	if (next != -1)
 	{
-		i = atoi(tmp);
-		if (i >= id || !todos[i].repr)
-			return (0);
-		*body = strdup(todos[i].repr);
-		length = todos[i].repr_len;
+		sprintf(next_cursor, "%d", next);
+		response_header(res, "X-Next-Cursor", next_cursor);
 	}
-	else
+	response_body(res, "application/json", body, len);
+	response_own(res, body, free);
+	return (0);
+}
+
+/**
+ * read_todos - writes the next chunk of a streamed list of todos, with the
+ *              store read-locked for that chunk only
+ * @reader: position in the list
+ * @buf: where to write
+ * @cap: at most that many bytes
+ * Return: number of bytes written, 0 once the list is complete, -1 on
+ *         allocation failure
+ */
+static ssize_t read_todos(void *reader, char *buf, size_t cap)
+{
+	ssize_t n;
+
+	pthread_rwlock_rdlock(&todos_lock);
+	n = todo_store_read(&todos, reader, buf, cap);
+	pthread_rwlock_unlock(&todos_lock);
+	return (n);
+}
+
+/**
+ * release_reader - releases the position of a streamed list of todos
+ * @reader: position in the list
+ */
+static void release_reader(void *reader)
+{
+	free(((todo_reader_t *)reader)->spill);
+	free(reader);
+}
+
+/**
+ * respond_stream - streams the list of every todo as the body of a
+ *                  response, a chunk at a time as the client takes them
+ * @res: response, with its status line
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int respond_stream(response_t *res)
+{
+	todo_reader_t *reader = calloc(1, sizeof(*reader));
+
+	if (!reader)
+		return (-1);
+	return (response_stream(res, "application/json", read_todos, reader,
+		release_reader));
+}
+
+/**
+ * process_get_request - processes a get request
+ * The list of every todo is the JSON snapshot of the store, serialized
+ * again only after POST or DELETE requests changed it, and sent as is: the
+ * response holds a reference to it until sent. A limit or cursor parameter
+ * asks for a page of it instead, see respond_page. Over TODO_STREAM_MIN
+ * bytes, the list is streamed to HTTP/1.1 clients rather than serialized
+ * whole, see respond_stream.
+ * @request: pointer to struct describing request
+ * @todos: todo store, read-locked
+ * @res: response, with its status line
+ * Return: 0 on success, -1 if there is no such todo
+ */
+int process_get_request(http_request_t *request, todo_store_t *todos,
+	response_t *res)
+{
+	static pthread_mutex_t json_lock = PTHREAD_MUTEX_INITIALIZER;
+	http_params_t const *params = &request->query_params;
+	http_slice_t const *tmp = get_param(request, params, "id"), *limit,
+		*cursor;
+	todo_t const *todo;
+	todo_t view;
+	todo_json_t *json;
+
+	if (tmp)
 	{
-		*body = malloc(sizeof(char) * (sum_repr_lens + 3));
-		**body = '[';
-		for (i = 0, length = 1, delim = ""; i < id; i++)
-			if (todos[i].repr)
-			{
-				length += sprintf(*body + length, "%s%s", delim, todos[i].repr);
-				delim = ",";
-			}
-		(*body)[length++] = ']';
-		(*body)[length] = '\0';
+		todo = todo_store_get(todos, atoi(request->raw + tmp->off),
+			&view);
+		return (todo ? respond_todo(res, todo) : -1);
 	}
-
-	return (length);
+	limit = get_param(request, params, "limit");
+	cursor = get_param(request, params, "cursor");
+	if (limit || cursor)
+		return (respond_page(request, todos, limit, cursor, res));
+	if (todos->repr_lens >= TODO_STREAM_MIN &&
+		http_slice_is(request, request->version, "HTTP/1.1"))
+		return (respond_stream(res));
+	pthread_mutex_lock(&json_lock);
+	json = todo_store_json(todos);
+	pthread_mutex_unlock(&json_lock);
+	if (!json)
+		return (-1);
+	response_body(res, "application/json", json->data, json->len);
+	response_own(res, json, release_json);
+	return (0);
 }
 
 /**
  * process_delete_request - processes a delete request
+ * The todo is deleted once the deletion is durable. Deleting a todo twice
+ * at once answers both requests with 204, the second deletion changing
+ * nothing.
  * @request: pointer to struct that describes request
- * @todos: pointer to link list of todo items
- * @id: max id value allowed
- * @sum_repr_lens: length of the sum of all representations
- * Return: "\r\n" on success and NULL on failure
+ * @todos: todo store
+ * @res: response, with its status line
+ * @waiter: told once the deletion is applied, see todo_log_delete
+ * Return: 0 on success, -1 if there is no such todo, -2 if the deletion
+ *         cannot be logged
  */
-char *process_delete_request(http_request_t *request,
-todo_t *todos, int id, int *sum_repr_lens)
+int process_delete_request(http_request_t *request, todo_store_t *todos,
+	response_t *res, todo_waiter_t *waiter)
 {
-	char *tmp = get_param(request->query_params, "id");
-	int i;
-
-	if (!tmp)
-		return (NULL);
-
-	i = atoi(tmp);
+	http_slice_t const *tmp = get_param(request, &request->query_params,
+		"id");
+	int id = tmp ? atoi(request->raw + tmp->off) : 0, found;
+	todo_t view;
 
-	if (i >= id || !todos[i].repr)
-		return (NULL);
+	pthread_rwlock_rdlock(&todos_lock);
+	found = tmp && todo_store_get(todos, id, &view);
+	pthread_rwlock_unlock(&todos_lock);
+	if (!found)
+		return (-1);
+	if (todo_log_delete(&todos_log, id, waiter) == -1)
+		return (-2);
+	response_text(res, "HTTP/1.1 204 No Content\r\n\r\n");
+	return (0);
+}
 
-	*sum_repr_lens -= todos[i].repr_len;
+/**
+ * process_post_request - processes a post request
+ * The todo is added once the addition is durable, the response being built
+ * meanwhile as the store will hold it.
+ * @request: pointer to struct that describes request
+ * @res: response, with its status line
+ * @waiter: told once the addition is applied, see todo_log_add
+ * Return: 0 on success, -1 if a parameter is missing, -2 if the addition
+ *         cannot be logged
+ */
+int process_post_request(http_request_t *request, response_t *res,
+	todo_waiter_t *waiter)
+{
+	http_slice_t const *title, *description;
+	char const *raw = request->raw;
+	char *body;
+	int id, len;
 
-	memset(&todos[i], 0, sizeof(todo_t));
-	return (strdup("\r\n"));
+	title = get_param(request, &request->body_params, "title");
+	description = get_param(request, &request->body_params,
+		"description");
+	if (!title || !description)
+		return (-1);
+	body = malloc(title->len + description->len + 64);
+	id = body ? todo_log_add(&todos_log, raw + title->off, title->len,
+		raw + description->off, description->len, waiter) : -1;
+	if (id == -1)
+	{
+		free(body);
+		return (-2);
+	}
+	len = sprintf(body, "{\"id\":%d,\"title\":\"%.*s\","
+		"\"description\":\"%.*s\"}", id, (int)title->len,
+		raw + title->off, (int)description->len,
+		raw + description->off);
+	response_body(res, "application/json", body, len);
+	response_own(res, body, free);
+	return (0);
 }
 
 /**
  * process_request - processes a request
+ * The todo store is shared by every thread serving requests: GET requests
+ * read it under a shared lock. POST and DELETE requests only log their
+ * change, applied by the log thread once durable: their response is ready
+ * once waiter is told, see http_commit.
  *
  * @request: pointer to request
- * Return: response to send back
+ * @res: response, with its status line
+ * @waiter: waiter of the change the request makes
+ * Return: 0 once the response is built, -1 on failure, -2 if the change
+ *         cannot be logged
  */
-char *process_request(http_request_t *request)
+int process_request(http_request_t *request, response_t *res,
+	todo_waiter_t *waiter)
 {
-	char *title, *description, *response, *body = NULL;
-	static todo_t todos[100];
-	static int id, sum_repr_lens;
-	size_t length;
-
-#ifdef TODO_API_7
-	if (request->method == DELETE)
-		return (process_delete_request(request, todos, id, &sum_repr_lens));
-#endif
+	static pthread_once_t loaded = PTHREAD_ONCE_INIT;
+	int ret;
 
+	pthread_once(&loaded, load_todos);
 	if (request->method == GET)
 	{
-		length = process_get_request(request, &body, todos, sum_repr_lens, id);
+		pthread_rwlock_rdlock(&todos_lock);
+		ret = process_get_request(request, &todos, res);
+		pthread_rwlock_unlock(&todos_lock);
+		return (ret);
 	}
-	else
-	{
-		title = get_param(request->body_params, "title");
-		description = get_param(request->body_params, "description");
-
-		if (!title || !description)
-			return (NULL);
+#ifdef TODO_API_7
+	if (request->method == DELETE)
+		return (process_delete_request(request, &todos, res, waiter));
+#endif
+	return (process_post_request(request, res, waiter));
+}
 
-		add_todo(todos, id, title, description);
-		sum_repr_lens += todos[id].repr_len;
-		body = strdup(todos[id].repr);
-		length = todos[id].repr_len;
-		id++;
-	}
+/**
+ * http_commit - completes a response held until the change made by its
+ *               request is applied, see http_respond
+ * A change that was dropped is answered with an error instead.
+ * @res: response
+ * @status: status of the waiter of the change
+ */
+void http_commit(response_t *res, int status)
+{
+	char const *connection = res->connection;
 
-#define RES_STR \
-"Content-Length: %lu\r\n" \
-"Content-Type: application/json\r\n" \
-"\r\n" \
-"%s" /* body goes here */
-	if (!body)
-		return (NULL);
-	response = calloc(length + sizeof(RES_STR) + 10, sizeof(char));
-	sprintf(response, RES_STR, length, body);
-	free(body);
-	return (response);
+	if (!status)
+		return;
+	response_release(res);
+	response_status(res, "500 Internal Server Error");
+	response_body(res, NULL, NULL, 0);
+	res->connection = connection;
 }
 
 /**
- * make_response - responds to a request
+ * http_respond - responds to a request
  * @client_address: client address (ignored)
  * @buffer: buffer where client's request is stored.
- * Return: response
+ * @res: response to fill, to release with response_release once sent
+ * @waiter: waiter of the change the request makes, if any: its lsn is
+ *          then set, and res is only complete once it is told, see
+ *          http_commit
+ * Return: 1 if the connection may persist, 0 if it must be closed
  */
-char *make_response(char *client_address, char *buffer)
+int http_respond(char *client_address, char *buffer, response_t *res,
+	todo_waiter_t *waiter)
 {
-	char *method, *uri, *status, *res, *response = NULL;
-	struct http_request_s *request;
+	char *status;
+	http_request_t request;
+	int done = false, ret, keep_alive;
 
 	(void)client_address;
+	waiter->lsn = 0;
 
-	request = http_request_init(buffer);
-	if (!request)
+	ret = http_request_parse(&request, buffer, strlen(buffer));
+	keep_alive = ret == 0 && http_keep_alive(&request);
+	if (ret == -1)
 		status = "400 Bad Request";
-	else if (!known_uri(request))
+	else if (!known_uri(&request))
 		status = "404 Not Found";
-	else if (request->method == POST &&
-		!get_header(request->headers, "Content-Length"))
+	else if (request.method == POST &&
+		!get_header(&request, Content_Length))
 		status = "411 Length Required";
 	else
 	{
-		response = process_request(request);
-		if (!response)
-			status = (request->method == POST) ?
+		status = request.method == POST ? "201 Created" : "200 OK";
+		response_status(res, status);
+		ret = process_request(&request, res, waiter);
+		done = ret == 0;
+		if (ret == -2)
+			status = "500 Internal Server Error";
+		else if (!done)
+			status = (request.method == POST) ?
 				"422 Unprocessable Entity" : "404 Not Found";
-		else if (request->method == POST)
-			status = "201 Created";
-		else if (request->method == DELETE)
+		else if (request.method == DELETE)
 			status = "204 No Content";
-		else
-			status = "200 OK";
 	}
 
-	method = request ? request->method_str : strtok(buffer, " ");
-	uri = request ? request->uri : strtok(NULL, "? ");
-	printf("%s %s -> %s\n", method, uri, status);
-	res = calloc(1024, sizeof(char));
-	sprintf(res, "HTTP/1.1 %s\r\n%s", status, response ? response : "\r\n");
-	free_http_request(request);
-	free(response);
-	return (res);
+	printf("%.*s %.*s -> %s\n", (int)request.method_str.len,
+		buffer + request.method_str.off, (int)request.uri.len,
+		buffer + request.uri.off, status);
+	if (done)
+		return (keep_alive);
+	/* Bodyless errors still say so, persistent connections need it */
+	response_status(res, status);
+	response_body(res, NULL, NULL, 0);
+	return (keep_alive);
+}
+
+/**
+ * make_response - responds to a request, as a single string
+ * A change the request makes is waited for, see todo_log_sync.
+ * @client_address: client address (ignored)
+ * @buffer: buffer where client's request is stored.
+ * Return: response
+ */
+char *make_response(char *client_address, char *buffer)
+{
+	todo_waiter_t waiter;
+	response_t res;
+	char *str;
+
+	waiter.done = NULL;
+	http_respond(client_address, buffer, &res, &waiter);
+	if (waiter.lsn)
+		http_commit(&res, todo_log_sync(&todos_log, &waiter));
+	str = response_flatten(&res);
+	response_release(&res);
+	return (str);
 }
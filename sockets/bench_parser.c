@@ -0,0 +1,224 @@
+#include "sockets.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "http_request_parser.c"
+#include "http_request_utils.c"
+
+/*
+ * Microbenchmark of http_request_parse(): parses every request of a corpus
+ * over and over and reports the time per request and the throughput of the
+ * delimiter scan it was built with, see http_findchar(). The digest of the
+ * slices found must be the same for every scan.
+ *
+ *   curl     GET as sent by curl, three short headers
+ *   form     POST of a todo as sent by curl -d
+ *   browser  GET as sent by a browser, long Accept, User-Agent and Cookie
+ *
+ * Requests recorded elsewhere (e.g. nc -l 8080 > request.txt) can be added
+ * to the corpus by passing their files.
+ *
+ * make bench_http, or
+ * gcc -O2 [-DHTTP_NO_SIMD | -msse4.2 | -mavx2] bench_parser.c
+ * ./a.out [iterations] [request files...]
+ */
+
+#if defined(HTTP_NO_SIMD)
+#define SCAN "scalar"
+#elif defined(__AVX2__)
+#define SCAN "avx2"
+#elif defined(__SSE4_2__)
+#define SCAN "sse4.2"
+#elif defined(__SSE2__)
+#define SCAN "sse2"
+#else
+#define SCAN "scalar"
+#endif
+
+#define CORPUS_MAX 32
+
+/**
+ * struct corpus_s - Request parsed by the benchmark
+ *
+ * @name: Name printed in the results
+ * @raw:  Raw request, NUL-terminated
+ * @len:  Length of the request
+ */
+typedef struct corpus_s
+{
+	char const *name;
+	char *raw;
+	size_t len;
+} corpus_t;
+
+static char curl_get[] =
+	"GET /todos HTTP/1.1\r\n"
+	"Host: localhost:8080\r\n"
+	"User-Agent: curl/7.88.1\r\n"
+	"Accept: */*\r\n"
+	"\r\n";
+
+static char curl_form[] =
+	"POST /todos HTTP/1.1\r\n"
+	"Host: localhost:8080\r\n"
+	"User-Agent: curl/7.88.1\r\n"
+	"Accept: */*\r\n"
+	"Content-Length: 43\r\n"
+	"Content-Type: application/x-www-form-urlencoded\r\n"
+	"\r\n"
+	"title=Dinner&description=Buy+bread+and+wine";
+
+static char browser_get[] =
+	"GET /todos?id=12 HTTP/1.1\r\n"
+	"Host: localhost:8080\r\n"
+	"Connection: keep-alive\r\n"
+	"sec-ch-ua: \"Chromium\";v=\"118\", \"Google Chrome\";v=\"118\", "
+	"\"Not=A?Brand\";v=\"99\"\r\n"
+	"sec-ch-ua-mobile: ?0\r\n"
+	"sec-ch-ua-platform: \"Linux\"\r\n"
+	"Upgrade-Insecure-Requests: 1\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+	"(KHTML, like Gecko) Chrome/118.0.0.0 Safari/537.36\r\n"
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+	"image/avif,image/webp,image/apng,*/*;q=0.8,"
+	"application/signed-exchange;v=b3;q=0.7\r\n"
+	"Sec-Fetch-Site: none\r\n"
+	"Sec-Fetch-Mode: navigate\r\n"
+	"Sec-Fetch-User: ?1\r\n"
+	"Sec-Fetch-Dest: document\r\n"
+	"Accept-Encoding: gzip, deflate, br\r\n"
+	"Accept-Language: en-US,en;q=0.9,fr;q=0.8\r\n"
+	"Cookie: _ga=GA1.1.1234567890.1697040000; "
+	"session=eyJ1c2VyIjoiYWRhIiwiZXhwIjoxNjk3MTI2NDAwfQ.c2lnbmF0dXJl; "
+	"theme=dark; _ga_XYZ=GS1.1.1697040000.3.1.1697040100.0.0.0\r\n"
+	"\r\n";
+
+/**
+ * now_ns - reads the monotonic clock
+ * Return: time in ns
+ */
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+/**
+ * load_request - reads a recorded request from a file
+ *
+ * @corpus: corpus entry to fill
+ * @path: file holding the request
+ * Return: 0 on success, -1 on failure
+ */
+static int load_request(corpus_t *corpus, char const *path)
+{
+	FILE *file = fopen(path, "rb");
+	long size;
+
+	if (!file)
+		return (-1);
+	if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0 ||
+		fseek(file, 0, SEEK_SET))
+		size = -1;
+	corpus->raw = size < 0 ? NULL : malloc(size + 1);
+	if (!corpus->raw || fread(corpus->raw, 1, size, file) != (size_t)size)
+	{
+		free(corpus->raw);
+		fclose(file);
+		return (-1);
+	}
+	fclose(file);
+	corpus->raw[size] = '\0';
+	corpus->name = path;
+	corpus->len = size;
+	return (0);
+}
+
+/**
+ * digest - hashes the slices of a parsed request
+ *
+ * @request: parsed request
+ * Return: FNV-1a hash of the slices
+ */
+static unsigned long digest(http_request_t const *request)
+{
+	unsigned char const *p = (unsigned char const *)request->headers;
+	unsigned long hash = 2166136261UL;
+	size_t i;
+
+	hash = (hash ^ request->uri.len ^ request->query.off << 8 ^
+		request->body.off << 16) * 16777619UL;
+	hash = (hash ^ request->query_params.count ^
+		request->body_params.count << 8) * 16777619UL;
+	for (i = 0; i < request->nb_headers * sizeof(*request->headers); i++)
+		hash = (hash ^ p[i]) * 16777619UL;
+	return (hash & 0xffffffffUL);
+}
+
+/**
+ * bench_request - times the parsing of one request
+ *
+ * @corpus: request
+ * @iterations: number of parses
+ * Return: 0 on success, -1 if the request does not parse
+ */
+static int bench_request(corpus_t const *corpus, size_t iterations)
+{
+	static http_request_t request;
+	double start, ns;
+	size_t i;
+
+	if (http_request_parse(&request, corpus->raw, corpus->len))
+		return (-1);
+	start = now_ns();
+	for (i = 0; i < iterations; i++)
+		http_request_parse(&request, corpus->raw, corpus->len);
+	ns = (now_ns() - start) / iterations;
+	printf("%-10.10s %6lu %3lu %-7s %9.1f %9.0f %08lx\n", corpus->name,
+		(unsigned long)corpus->len, (unsigned long)request.nb_headers,
+		SCAN, ns, corpus->len / ns * 1e3, digest(&request));
+	return (0);
+}
+
+/**
+ * main - Entry point
+ *
+ * @ac: Arguments count
+ * @av: Arguments vector
+ *
+ * Return: EXIT_SUCCESS upon success, EXIT_FAILURE otherwise
+ */
+int main(int ac, char **av)
+{
+	corpus_t corpus[CORPUS_MAX] = {
+		{"curl", curl_get, sizeof(curl_get) - 1},
+		{"form", curl_form, sizeof(curl_form) - 1},
+		{"browser", browser_get, sizeof(browser_get) - 1}
+	};
+	size_t iterations = ac > 1 ? strtoul(av[1], NULL, 10) : 1000000;
+	size_t n = 3, i;
+	int ret = 0;
+
+	for (i = 2; (int)i < ac && n < CORPUS_MAX; i++)
+		if (load_request(corpus + n, av[i]) == 0)
+			n++;
+		else
+			fprintf(stderr, "%s: cannot read\n", av[i]);
+	if (!iterations)
+		return (EXIT_FAILURE);
+	printf("%lu parses per request\n", (unsigned long)iterations);
+	printf("%-10s %6s %3s %-7s %9s %9s %8s\n", "request", "bytes", "hdr",
+		"scan", "ns/req", "MB/s", "digest");
+	for (i = 0; i < n; i++)
+		if (bench_request(corpus + i, iterations) == -1)
+		{
+			fprintf(stderr, "%s: parse error\n", corpus[i].name);
+			ret = -1;
+		}
+	for (i = 3; i < n; i++)
+		free(corpus[i].raw);
+	return (ret ? EXIT_FAILURE : EXIT_SUCCESS);
+}
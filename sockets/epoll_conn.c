@@ -0,0 +1,336 @@
+#include "epoll_server.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+/**
+ * now_seconds - reads the monotonic clock
+ *
+ * Return: seconds elapsed since an arbitrary point
+ */
+static long now_seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec);
+}
+
+/**
+ * conn_unlink - removes a connection from the table of its reactor
+ *
+ * @conn: connection
+ */
+static void conn_unlink(conn_t *conn)
+{
+	reactor_t *reactor = conn->reactor;
+
+	if (conn->prev)
+		conn->prev->next = conn->next;
+	else
+		reactor->conns = conn->next;
+	if (conn->next)
+		conn->next->prev = conn->prev;
+	else
+		reactor->oldest = conn->prev;
+	conn->prev = conn->next = NULL;
+}
+
+/**
+ * conn_touch - marks a connection as just active, moving it to the head of
+ *              the table so the table stays sorted by last activity
+ *
+ * @conn: connection, already in the table
+ */
+static void conn_touch(conn_t *conn)
+{
+	reactor_t *reactor = conn->reactor;
+
+	conn->active = now_seconds();
+	if (reactor->conns == conn)
+		return;
+	conn_unlink(conn);
+	conn->next = reactor->conns;
+	if (conn->next)
+		conn->next->prev = conn;
+	else
+		reactor->oldest = conn;
+	reactor->conns = conn;
+}
+
+/**
+ * conn_open - allocates the state of a new client connection and adds it
+ *             to the connection table of a reactor
+ *
+ * @reactor: reactor serving the connection
+ * @fd: client socket, already non-blocking
+ * @addr: client address
+ * Return: the connection, NULL on failure
+ */
+conn_t *conn_open(reactor_t *reactor, int fd, struct sockaddr_in const *addr)
+{
+	conn_t *conn = calloc(1, sizeof(*conn));
+
+	if (!conn)
+		return (NULL);
+	if (request_reserve(&conn->in) == -1)
+	{
+		free(conn);
+		return (NULL);
+	}
+	conn->fd = fd;
+	conn->state = CONN_OPEN;
+	conn->active = now_seconds();
+	inet_ntop(AF_INET, &addr->sin_addr, conn->address,
+		sizeof(conn->address));
+	conn->reactor = reactor;
+	zc_enable(conn);
+	conn->next = reactor->conns;
+	if (conn->next)
+		conn->next->prev = conn;
+	else
+		reactor->oldest = conn;
+	reactor->conns = conn;
+	__atomic_add_fetch(&reactor->nb_conns, 1, __ATOMIC_RELAXED);
+	return (conn);
+}
+
+/**
+ * conn_close - closes a client connection, removes it from the table of
+ *              its reactor and releases its state
+ * A connection with parked responses is freed by reactor_settle once their
+ * changes are settled, the log thread still holding their waiters.
+ *
+ * @conn: connection
+ */
+void conn_close(conn_t *conn)
+{
+	conn_unlink(conn);
+	__atomic_sub_fetch(&conn->reactor->nb_conns, 1, __ATOMIC_RELAXED);
+	close(conn->fd);
+	free(conn->in.data);
+	for (; conn->out_count; conn->out_count--)
+		response_release(conn->out + conn->out_first++);
+	free(conn->out);
+	zc_release(conn);
+	free(conn->waiter);
+	conn->state = CONN_CLOSED;
+	if (!conn->parked)
+		free(conn);
+}
+
+/**
+ * conn_read - receives everything available on a connection
+ * Edge-triggered: reads until the socket would block, then clears
+ * conn->readable until the next EPOLLIN. A full buffer always holds a
+ * complete or a rejected request, so reading resumes once it is answered.
+ *
+ * @conn: connection
+ * Return: number of bytes received, -1 if the connection must be closed
+ */
+static ssize_t conn_read(conn_t *conn)
+{
+	request_buf_t *in = &conn->in;
+	ssize_t n, total = 0;
+
+	while (1)
+	{
+		if (request_reserve(in) == -1)
+			return (in->cap < REQUEST_BUF_MAX ? -1 : total);
+		n = recv(conn->fd, in->data + in->len, in->cap - in->len, 0);
+		if (n <= 0)
+			break;
+		in->len += n, total += n;
+		in->data[in->len] = '\0';
+		if (conn->out_bytes >= OUTPUT_MAX)
+			return (total); /* Let the client read first */
+	}
+	if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+		return (-1);
+	conn->readable = 0;
+	if (n == 0)
+		conn->eof = 1;
+	return (total);
+}
+
+/**
+ * conn_gather - describes the queued responses to send with one sendmsg()
+ * The body of a response of conn->zerocopy bytes or more is sent alone,
+ * with MSG_ZEROCOPY: the kernel holds the pages of everything sent that way
+ * until it is done with them, and the heads live in the queue, which is
+ * reused as soon as they are sent. A streamed response ends the gathering,
+ * its next chunk being written once the current one is sent, into the same
+ * buffer: it is never sent with MSG_ZEROCOPY.
+ *
+ * @conn: connection, with responses to send
+ * @iov: WRITE_IOV entries to fill
+ * @zerocopy: set if the entry filled is a body to send with MSG_ZEROCOPY
+ * Return: number of entries filled
+ */
+static int conn_gather(conn_t *conn, struct iovec *iov, int *zerocopy)
+{
+	response_t const *res = conn->out + conn->out_first;
+	size_t i;
+	int n = 0;
+
+	*zerocopy = 0;
+	for (i = 0; i < conn->out_count && n + RESPONSE_IOV <= WRITE_IOV; i++)
+	{
+		if (res[i].hold)
+			break; /* Parked, and so are the ones after it */
+		n += response_iov(res + i, iov + n);
+		if (res[i].stream)
+			break; /* The next chunk is not written yet */
+		if (!conn->zerocopy || res[i].body_len < conn->zerocopy)
+			continue;
+		if (n == 1)
+			*zerocopy = 1; /* Only its body is left */
+		else
+			n--;
+		break;
+	}
+	return (n);
+}
+
+/**
+ * conn_write - sends as much of the queued responses as the socket takes
+ * Responses are sent in pieces straight from where they were built, as
+ * many as fit in WRITE_IOV iovecs per call, and released once sent. The
+ * chunks of a streamed response are written as the socket takes them.
+ *
+ * @conn: connection
+ * Return: 1 once every response is sent, 0 if the socket is full or the
+ *         next response is parked, -1 if the connection must be closed
+ */
+static int conn_write(conn_t *conn)
+{
+	struct iovec iov[WRITE_IOV];
+	struct msghdr msg;
+	response_t *res;
+	ssize_t n;
+	int zerocopy, more;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	while (conn->out_count)
+	{
+		msg.msg_iovlen = conn_gather(conn, iov, &zerocopy);
+		if (!msg.msg_iovlen)
+			return (0);
+		if (zerocopy && zc_reserve(conn) == -1)
+			return (-1);
+		n = sendmsg(conn->fd, &msg,
+			MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0));
+		if (n == -1 && errno == ENOBUFS && zerocopy)
+		{
+			zerocopy = 0; /* Over optmem_max, copy instead */
+			n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+		}
+		if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return (0);
+		if (n == -1)
+			return (-1);
+		if (zerocopy)
+			zc_sent(conn, conn->out + conn->out_first);
+		conn->out_bytes -= n;
+		while (conn->out_count)
+		{
+			res = conn->out + conn->out_first;
+			n -= response_advance(res, n);
+			if (res->sent < response_len(res))
+				break;
+			more = response_more(res);
+			if (more == -1)
+				return (-1);
+			conn->out_bytes += more ? res->body_len : 0;
+			if (more)
+				break;
+			zc_done(conn);
+			response_release(res);
+			conn->out_first++, conn->out_count--;
+		}
+	}
+	conn->out_first = 0;
+	return (1);
+}
+
+/**
+ * conn_done - tells whether a connection has nothing left to do
+ *
+ * @conn: connection
+ * Return: 1 if every response is sent and no more are to come, 0 otherwise
+ */
+static int conn_done(conn_t *conn)
+{
+	size_t len;
+
+	if (conn->out_count || conn->zc_count)
+		return (0);
+	if (conn->state == CONN_DRAINING)
+		return (1);
+	if (!conn->eof || request_check(conn->in.data, conn->in.len, &len))
+		return (0);
+	return (!len);
+}
+
+/**
+ * conn_handle - moves a connection forward on an epoll event
+ * A connection is registered for both EPOLLIN and EPOLLOUT, edge-triggered,
+ * so it reads, answers and writes until neither side can make progress.
+ * Responses to pipelined requests are queued in order; the connection stays
+ * open for more unless a request asked otherwise, the client went away or
+ * it sits idle for KEEPALIVE_TIMEOUT seconds (see conn_sweep).
+ *
+ * @conn: connection
+ * @events: epoll events of the connection
+ */
+void conn_handle(conn_t *conn, unsigned int events)
+{
+	ssize_t got;
+	int answered, sent, pending;
+
+	if ((events & EPOLLERR) && zc_reap(conn) == -1)
+		conn->state = CONN_CLOSED;
+	if (events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP))
+		conn->readable = 1;
+	conn_touch(conn);
+	while (conn->state != CONN_CLOSED)
+	{
+		got = 0;
+		if (conn->state == CONN_OPEN && conn->readable)
+			got = conn_read(conn);
+		answered = got == -1 ? -1 : conn_respond(conn);
+		pending = conn->out_count > 0; /* May have paused answering */
+		sent = answered == -1 ? -1 : conn_write(conn);
+		if (sent == -1 || (sent == 1 && conn_done(conn)))
+			conn->state = CONN_CLOSED;
+		else if (!sent ||
+			(!got && !answered && !pending && !conn->readable))
+			break;
+	}
+	if (conn->state == CONN_CLOSED)
+		conn_close(conn);
+}
+
+/**
+ * conn_sweep - closes the connections of a reactor idle for
+ *              KEEPALIVE_TIMEOUT seconds
+ * The table is sorted by last activity, so only its tail is visited.
+ *
+ * @reactor: reactor
+ */
+void conn_sweep(reactor_t *reactor)
+{
+	long now = now_seconds();
+
+	while (reactor->oldest &&
+		now - reactor->oldest->active >= KEEPALIVE_TIMEOUT)
+	{
+		conn_close(reactor->oldest);
+		__atomic_add_fetch(&reactor->timeouts, 1, __ATOMIC_RELAXED);
+	}
+}
@@ -0,0 +1,264 @@
+#define _GNU_SOURCE /* accept4 */
+#include "epoll_server.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+/**
+ * listen_socket - opens a non-blocking listening socket on PORT
+ * SO_REUSEPORT lets every reactor bind its own socket to the same port; the
+ * kernel then hashes incoming connections among them.
+ *
+ * Return: the socket, -1 on failure
+ */
+int listen_socket(void)
+{
+	int server_id, on = 1;
+	struct sockaddr_in addr;
+
+	server_id = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK, IPPROTO_TCP);
+	if (server_id == -1)
+		return (-1);
+
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if (setsockopt(server_id, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) ||
+		setsockopt(server_id, SOL_SOCKET, SO_REUSEPORT, &on,
+			sizeof(on)) ||
+		bind(server_id, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+		listen(server_id, SOMAXCONN) == -1)
+	{
+		close(server_id);
+		return (-1);
+	}
+	return (server_id);
+}
+
+/**
+ * listener_watch - registers the listening socket of a reactor with epoll
+ *
+ * @reactor: reactor
+ * Return: 0 on success, -1 on failure
+ */
+static int listener_watch(reactor_t *reactor)
+{
+	struct epoll_event ev;
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL; /* Marks the listening socket */
+	return (epoll_ctl(reactor->epoll_id, EPOLL_CTL_ADD, reactor->server_id,
+		&ev));
+}
+
+/**
+ * accept_refuse - sheds a pending connection when out of file descriptors
+ * The level-triggered listener would otherwise wake the loop over and over
+ * while the connection waits. The spare descriptor of the reactor makes
+ * room to accept the client, which is closed at once. If there is no spare
+ * or the system is out of files too, the listener leaves epoll until
+ * reactor_run puts it back a second later.
+ *
+ * @reactor: reactor
+ * Return: 1 if a connection was shed, 0 if there is none or on pause
+ */
+static int accept_refuse(reactor_t *reactor)
+{
+	int client_id = -1, err = EMFILE;
+
+	if (reactor->spare_fd != -1)
+	{
+		close(reactor->spare_fd);
+		client_id = accept(reactor->server_id, NULL, NULL);
+		err = errno;
+		if (client_id != -1)
+			close(client_id);
+		reactor->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	}
+	if (client_id != -1)
+		__atomic_add_fetch(&reactor->refused, 1, __ATOMIC_RELAXED);
+	else if ((err == EMFILE || err == ENFILE) &&
+		!epoll_ctl(reactor->epoll_id, EPOLL_CTL_DEL, reactor->server_id,
+			NULL))
+	{
+		errno = err;
+		perror("accept4");
+		reactor->paused = time(NULL);
+	}
+	return (client_id != -1);
+}
+
+/**
+ * accept_clients - accepts every pending connection of a reactor
+ * Each client socket is made non-blocking and registered for edge-triggered
+ * reads and writes, with its connection state as epoll data.
+ *
+ * @reactor: reactor
+ */
+static void accept_clients(reactor_t *reactor)
+{
+	struct sockaddr_in client_addr;
+	socklen_t addr_size = sizeof(client_addr);
+	struct epoll_event ev;
+	conn_t *conn;
+	int client_id;
+
+	while (1)
+	{
+		client_id = accept4(reactor->server_id,
+			(struct sockaddr *)&client_addr, &addr_size,
+			SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (client_id == -1)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if ((errno == EMFILE || errno == ENFILE) &&
+				accept_refuse(reactor))
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK &&
+				errno != EMFILE && errno != ENFILE)
+				perror("accept4");
+			return;
+		}
+		__atomic_add_fetch(&reactor->accepted, 1, __ATOMIC_RELAXED);
+		conn = conn_open(reactor, client_id, &client_addr);
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		ev.data.ptr = conn;
+		if (!conn)
+			close(client_id);
+		else if (epoll_ctl(reactor->epoll_id, EPOLL_CTL_ADD, client_id,
+			&ev) == -1)
+			conn_close(conn);
+	}
+}
+
+/**
+ * reactor_close - closes the descriptors of a reactor
+ *
+ * @reactor: reactor
+ */
+void reactor_close(reactor_t *reactor)
+{
+	int *fds[4], i;
+
+	fds[0] = &reactor->server_id, fds[1] = &reactor->epoll_id;
+	fds[2] = &reactor->wake_fd, fds[3] = &reactor->spare_fd;
+	for (i = 0; i < 4; i++)
+	{
+		if (*fds[i] != -1)
+			close(*fds[i]);
+		*fds[i] = -1;
+	}
+}
+
+/**
+ * reactor_open - opens the listening socket, epoll instance and eventfd of
+ *                a reactor, before its thread starts
+ * The listening socket is only opened along with the rest, so that no
+ * connection goes to a reactor that cannot serve it.
+ *
+ * @reactor: reactor
+ * Return: 0 on success, -1 on failure, with nothing left open
+ */
+int reactor_open(reactor_t *reactor)
+{
+	struct epoll_event ev;
+	int err;
+
+	reactor->server_id = listen_socket();
+	reactor->epoll_id = epoll_create1(EPOLL_CLOEXEC);
+	reactor->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	reactor->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	reactor->paused = 0;
+	ev.events = EPOLLIN;
+	ev.data.ptr = &reactor->wake_fd; /* Marks the eventfd */
+	if (reactor->server_id != -1 && reactor->epoll_id != -1 &&
+		reactor->wake_fd != -1 && !listener_watch(reactor) &&
+		!epoll_ctl(reactor->epoll_id, EPOLL_CTL_ADD, reactor->wake_fd,
+			&ev))
+	{
+		pthread_mutex_init(&reactor->settled_lock, NULL);
+		reactor->alive = 1;
+		return (0);
+	}
+	err = errno;
+	reactor_close(reactor);
+	errno = err;
+	return (-1);
+}
+
+/**
+ * reactor_stop - closes everything a reactor holds once its event loop
+ *                fails, and tells the main thread with SIGUSR2
+ * Its listening socket would otherwise go on getting its share of the new
+ * connections, with nobody to accept them. Waiters settled from now on are
+ * left with the reactor, see conn_settled.
+ *
+ * @reactor: reactor
+ */
+static void reactor_stop(reactor_t *reactor)
+{
+	while (reactor->conns)
+		conn_close(reactor->conns);
+	pthread_mutex_lock(&reactor->settled_lock);
+	reactor_close(reactor);
+	pthread_mutex_unlock(&reactor->settled_lock);
+	__atomic_store_n(&reactor->alive, 0, __ATOMIC_RELEASE);
+	kill(getpid(), SIGUSR2);
+}
+
+/**
+ * reactor_run - thread entry serving the clients of one reactor
+ * epoll_wait wakes up at least every second to close idle connections and
+ * to put back a listener paused for lack of file descriptors. Its eventfd
+ * wakes it up as the log thread settles parked responses.
+ *
+ * @reactor: reactor, opened by reactor_open
+ * Return: NULL, only if epoll fails
+ */
+void *reactor_run(reactor_t *reactor)
+{
+	struct epoll_event events[MAX_EVENTS];
+	time_t swept = time(NULL);
+	int n, i;
+
+	while (1)
+	{
+		n = epoll_wait(reactor->epoll_id, events, MAX_EVENTS, 1000);
+		if (n == -1 && errno != EINTR)
+		{
+			perror("epoll_wait");
+			reactor_stop(reactor);
+			return (NULL);
+		}
+		for (i = 0; i < n; i++)
+			if (!events[i].data.ptr)
+				accept_clients(reactor);
+			else if (events[i].data.ptr == &reactor->wake_fd)
+				reactor_settle(reactor);
+			else
+				conn_handle(events[i].data.ptr,
+					events[i].events);
+		if (time(NULL) != swept)
+		{
+			conn_sweep(reactor);
+			swept = time(NULL);
+		}
+		if (reactor->paused && swept - reactor->paused >= 1 &&
+			!listener_watch(reactor))
+		{
+			reactor->paused = 0;
+			if (reactor->spare_fd == -1)
+				reactor->spare_fd = open("/dev/null",
+					O_RDONLY | O_CLOEXEC);
+		}
+	}
+}
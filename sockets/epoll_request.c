@@ -0,0 +1,204 @@
+#include "epoll_server.h"
+#include "request_reader.c"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STAT_INC(field) __atomic_add_fetch(&(field), 1, __ATOMIC_RELAXED)
+
+/**
+ * request_changes - tells whether a request may change the todo store
+ *
+ * @buf: complete request
+ * Return: 1 unless it is a GET or HEAD request
+ */
+static int request_changes(char const *buf)
+{
+	return (strncmp(buf, "GET ", 4) && strncmp(buf, "HEAD ", 5));
+}
+
+/**
+ * conn_settled - hands the waiter of a parked response back to the reactor
+ *                of its connection, see reactor_settle
+ * Called by the log thread, once the change of the request is applied or
+ * dropped. A stopped reactor keeps the waiters of its parked responses.
+ *
+ * @waiter: waiter, whose arg is the connection
+ */
+static void conn_settled(todo_waiter_t *waiter)
+{
+	reactor_t *reactor = ((conn_t *)waiter->arg)->reactor;
+	uint64_t one = 1;
+
+	waiter->next = NULL;
+	pthread_mutex_lock(&reactor->settled_lock);
+	if (reactor->settled_last)
+		reactor->settled_last->next = waiter;
+	else
+		reactor->settled = waiter;
+	reactor->settled_last = waiter;
+	if (reactor->wake_fd != -1 && /* Closed once the reactor stops */
+		write(reactor->wake_fd, &one, sizeof(one)) == -1)
+		perror("eventfd");
+	pthread_mutex_unlock(&reactor->settled_lock);
+}
+
+/**
+ * conn_park - holds a response until the change of its request is applied
+ *
+ * @conn: connection
+ * @res: response, just queued
+ */
+static void conn_park(conn_t *conn, response_t *res)
+{
+	res->hold = conn->waiter;
+	conn->waiter = NULL;
+	conn->parked++;
+}
+
+/**
+ * reactor_settle - completes the parked responses whose changes are
+ *                  settled, and moves their connections forward
+ * Called when the eventfd of the reactor is readable. A connection closed
+ * meanwhile is only freed once its last parked response is settled.
+ *
+ * @reactor: reactor
+ */
+void reactor_settle(reactor_t *reactor)
+{
+	todo_waiter_t *waiter, *next;
+	response_t *res;
+	conn_t *conn;
+	uint64_t n;
+	size_t i;
+
+	if (read(reactor->wake_fd, &n, sizeof(n)) == -1)
+		return;
+	pthread_mutex_lock(&reactor->settled_lock);
+	waiter = reactor->settled;
+	reactor->settled = reactor->settled_last = NULL;
+	pthread_mutex_unlock(&reactor->settled_lock);
+	for (; waiter; waiter = next)
+	{
+		next = waiter->next;
+		conn = waiter->arg;
+		conn->parked--;
+		for (i = 0; conn->state != CONN_CLOSED && i < conn->out_count;
+			i++)
+		{
+			res = conn->out + conn->out_first + i;
+			if (res->hold != waiter)
+				continue;
+			res->hold = NULL;
+			conn->out_bytes -= response_len(res);
+			http_commit(res, waiter->status);
+			conn->out_bytes += response_len(res);
+			break;
+		}
+		free(waiter);
+		if (conn->state != CONN_CLOSED)
+			conn_handle(conn, 0);
+		else if (!conn->parked)
+			free(conn);
+	}
+}
+
+/**
+ * conn_append - makes room for one more response at the end of the queue
+ *               of a connection
+ *
+ * @conn: connection
+ * Return: the response to fill, NULL on allocation failure
+ */
+static response_t *conn_append(conn_t *conn)
+{
+	response_t *tmp;
+
+	if (!conn->out_count)
+		conn->out_first = 0;
+	if (conn->out_first + conn->out_count == conn->out_cap &&
+		conn->out_first)
+	{
+		memmove(conn->out, conn->out + conn->out_first,
+			conn->out_count * sizeof(*conn->out));
+		conn->out_first = 0;
+	}
+	if (conn->out_count == conn->out_cap)
+	{
+		tmp = realloc(conn->out,
+			(conn->out_cap * 2 + 4) * sizeof(*tmp));
+		if (!tmp)
+			return (NULL);
+		conn->out = tmp;
+		conn->out_cap = conn->out_cap * 2 + 4;
+	}
+	return (conn->out + conn->out_first + conn->out_count);
+}
+
+/**
+ * conn_respond - answers every complete request buffered on a connection
+ * Pipelined requests are answered in order, until OUTPUT_MAX bytes are
+ * waiting to be sent or a request asks for the connection to be closed.
+ * A request over HEADERS_MAX or BODY_MAX is rejected and ends the
+ * connection, as there is no telling where the next one would start.
+ * The response to a change is parked until the log thread applies it, so
+ * the reactor never waits for the disk: pipelined changes go on being
+ * logged, to be made durable together, but a read waits for the changes
+ * before it to show up.
+ *
+ * @conn: connection
+ * Return: number of requests answered, -1 on allocation failure
+ */
+int conn_respond(conn_t *conn)
+{
+	char *in = conn->in.data, c;
+	size_t pos = 0, len;
+	int n = 0, keep_alive, status;
+	response_t *res;
+
+	while (conn->state == CONN_OPEN && conn->out_bytes < OUTPUT_MAX)
+	{
+		status = request_check(in + pos, conn->in.len - pos, &len);
+		if (!status && (!len ||
+			(conn->parked && !request_changes(in + pos))))
+			break;
+		res = conn_append(conn);
+		if (!conn->waiter)
+			conn->waiter = malloc(sizeof(*conn->waiter));
+		if (!res || !conn->waiter)
+			return (-1);
+		conn->waiter->done = conn_settled;
+		conn->waiter->arg = conn;
+		if (status)
+		{
+			response_text(res, request_reject(status));
+			keep_alive = 0;
+			len = conn->in.len - pos;
+		}
+		else
+		{
+			c = in[pos + len];
+			in[pos + len] = '\0'; /* http_respond reads to there */
+			keep_alive = http_respond(conn->address, in + pos, res,
+				conn->waiter);
+			in[pos + len] = c;
+			if (conn->waiter->lsn) /* Logged, see conn_settled */
+				conn_park(conn, res);
+		}
+		res->connection = keep_alive ? "Connection: keep-alive\r\n" :
+			"Connection: close\r\n";
+		conn->out_count++;
+		conn->out_bytes += response_len(res);
+		pos += len, n++;
+		STAT_INC(conn->reactor->requests);
+		if (conn->requests++)
+			STAT_INC(conn->reactor->reused);
+		if (!keep_alive)
+			conn->state = CONN_DRAINING;
+	}
+	memmove(in, in + pos, conn->in.len - pos + 1);
+	conn->in.len -= pos;
+	return (n);
+}
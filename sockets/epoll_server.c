@@ -0,0 +1,148 @@
+#define _GNU_SOURCE /* sched_getaffinity */
+#include "epoll_server.h"
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+/**
+ * raise_fd_limit - lets the process open as many sockets as allowed
+ */
+static void raise_fd_limit(void)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+	{
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+}
+
+/**
+ * nb_cpus - counts the CPUs the server may run on
+ *
+ * Return: number of CPUs in the affinity mask, at least 1
+ */
+static int nb_cpus(void)
+{
+	cpu_set_t set;
+
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		return (CPU_COUNT(&set));
+	return (1);
+}
+
+/**
+ * print_stats - prints the connection counters of every reactor
+ * Connection reuse is the share of requests served on a connection that
+ * already served one, as kept alive by the clients.
+ *
+ * @reactors: reactors
+ * @nb: number of reactors
+ */
+static void print_stats(reactor_t *reactors, int nb)
+{
+	unsigned long conns = 0, accepted = 0, requests = 0, reused = 0;
+	unsigned long timeouts = 0, refused = 0, r[6];
+	int i;
+
+	for (i = 0; i < nb; i++)
+	{
+		r[0] = __atomic_load_n(&reactors[i].nb_conns, __ATOMIC_RELAXED);
+		r[1] = __atomic_load_n(&reactors[i].accepted, __ATOMIC_RELAXED);
+		r[2] = __atomic_load_n(&reactors[i].requests, __ATOMIC_RELAXED);
+		r[3] = __atomic_load_n(&reactors[i].reused, __ATOMIC_RELAXED);
+		r[4] = __atomic_load_n(&reactors[i].timeouts, __ATOMIC_RELAXED);
+		r[5] = __atomic_load_n(&reactors[i].refused, __ATOMIC_RELAXED);
+		printf("reactor %d: %lu open, %lu accepted, %lu requests, "
+			"%lu reused, %lu timed out, %lu refused\n", i, r[0],
+			r[1], r[2], r[3], r[4], r[5]);
+		conns += r[0], accepted += r[1], requests += r[2];
+		reused += r[3], timeouts += r[4], refused += r[5];
+	}
+	printf("total: %lu open, %lu accepted, %lu requests, %lu timed out, "
+		"%lu refused, reuse %.1f%%, %.2f requests per connection\n",
+		conns, accepted, requests, timeouts, refused,
+		requests ? 100.0 * reused / requests : 0.0,
+		accepted ? (double)requests / accepted : 0.0);
+}
+
+/**
+ * reap_reactors - joins the reactors whose event loop stopped
+ *
+ * @reactors: reactors
+ * @nb: number of reactors
+ * Return: number of reactors joined
+ */
+static int reap_reactors(reactor_t *reactors, int nb)
+{
+	int i, joined = 0;
+
+	for (i = 0; i < nb; i++)
+	{
+		if (__atomic_load_n(&reactors[i].alive, __ATOMIC_ACQUIRE))
+			continue;
+		pthread_join(reactors[i].thread, NULL);
+		reactors[i].alive = -1;
+		fprintf(stderr, "Reactor %d stopped\n", i);
+		joined++;
+	}
+	return (joined);
+}
+
+/**
+ * main - REST API served by edge-triggered epoll event loops
+ *        Same endpoints as simple_server.c, but clients are served
+ *        concurrently with non-blocking sockets by one reactor thread per
+ *        CPU, so a slow client no longer stalls the others.
+ *        Sending SIGUSR1 prints the connection counters. A reactor whose
+ *        event loop fails sends SIGUSR2, and is joined.
+ *
+ * @ac: arguments count
+ * @av: arguments vector, av[1] may set the number of reactors
+ * Return: EXIT_FAILURE once no reactor runs, if any could start
+ */
+int main(int ac, char **av)
+{
+	static reactor_t reactors[MAX_REACTORS];
+	int nb = ac > 1 ? atoi(av[1]) : nb_cpus(), i, started = 0, live, sig;
+	sigset_t set;
+
+	nb = nb < 1 ? 1 : nb > MAX_REACTORS ? MAX_REACTORS : nb;
+	signal(SIGPIPE, SIG_IGN);
+	raise_fd_limit();
+	setbuf(stdout, NULL);
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	sigaddset(&set, SIGUSR2);
+	pthread_sigmask(SIG_BLOCK, &set, NULL); /* Inherited by the reactors */
+	for (i = 0; i < nb; i++)
+	{
+		reactors[i].id = i;
+		if (reactor_open(reactors + i) == -1)
+		{
+			perror("Reactor");
+			break;
+		}
+		if (pthread_create(&reactors[i].thread, NULL,
+			(void *(*)(void *))reactor_run, reactors + i))
+		{
+			reactor_close(reactors + i);
+			break;
+		}
+		started++;
+	}
+	if (!started)
+		return (EXIT_FAILURE);
+	printf("Server listening on port %d with %d reactors\n", PORT, started);
+	for (live = started; live && sigwait(&set, &sig) == 0;)
+		if (sig == SIGUSR1)
+			print_stats(reactors, started);
+		else
+			live -= reap_reactors(reactors, started);
+	fprintf(stderr, "No reactor left\n");
+	return (EXIT_FAILURE);
+}
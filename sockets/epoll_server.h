@@ -0,0 +1,196 @@
+#ifndef _EPOLL_SERVER_H_
+#define _EPOLL_SERVER_H_
+
+#include <stddef.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "request_reader.h"
+#include "http_response.h"
+#include "sockets.h"
+
+#define PORT 8080
+#define MAX_EVENTS 256 /* Events handled per epoll_wait() */
+#define OUTPUT_MAX 65536 /* Unsent bytes over which pipelining pauses */
+#define MAX_REACTORS 64
+#ifndef KEEPALIVE_TIMEOUT
+#define KEEPALIVE_TIMEOUT 5 /* Seconds without traffic before closing */
+#endif
+#define WRITE_IOV 64 /* Pieces of responses gathered per sendmsg() */
+#ifndef ZEROCOPY_MIN
+#define ZEROCOPY_MIN 0 /* Body size from which MSG_ZEROCOPY is used, 0: never */
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+typedef struct reactor_s reactor_t;
+
+/**
+ * struct zc_send_s - body sent with MSG_ZEROCOPY, held until the kernel
+ *                    tells it is done with it
+ * The kernel numbers the sendmsg() calls of a socket made with
+ * MSG_ZEROCOPY, and reports ranges of those numbers on the error queue of
+ * the socket once their pages are no longer in use.
+ * @first: number of the first call that sent part of the body
+ * @last: number of the last one
+ * @remaining: number of those calls not reported yet
+ * @done: set once the whole response is sent
+ * @owner: what holds the body, see response_own
+ * @release: releases owner
+ */
+typedef struct zc_send_s
+{
+	unsigned int first;
+	unsigned int last;
+	unsigned int remaining;
+	int          done;
+	void        *owner;
+	void       (*release)(void *owner);
+} zc_send_t;
+
+/**
+ * enum conn_state_e - state of a client connection
+ * @CONN_OPEN:     persistent, serving requests as they come
+ * @CONN_DRAINING: the last response is queued, close once it is sent
+ * @CONN_CLOSED:   done, the connection must be released
+ */
+typedef enum conn_state_e
+{
+	CONN_OPEN,
+	CONN_DRAINING,
+	CONN_CLOSED
+} conn_state_t;
+
+/**
+ * struct conn_s - client connection of the event loop
+ * @fd: client socket file descriptor, non-blocking
+ * @state: whether the connection still takes requests
+ * @readable: set until a read would block, edge-triggered epoll only tells
+ *            once
+ * @eof: set once the client shut its side down
+ * @address: client address, as passed to http_respond
+ * @in: request buffer, pipelined requests included
+ * @out: queue of responses being sent, in request order
+ * @out_first: position of the first response of the queue in out
+ * @out_count: number of responses in the queue
+ * @out_cap: size of out
+ * @out_bytes: number of bytes of the queued responses not sent yet
+ * @zerocopy: body size from which MSG_ZEROCOPY is used, 0 if the socket
+ *            does not take it
+ * @zc_next: number of the next sendmsg() call made with MSG_ZEROCOPY
+ * @zc: bodies sent with MSG_ZEROCOPY, not reported done by the kernel yet
+ * @zc_count: number of those
+ * @zc_cap: size of zc
+ * @requests: number of requests served on the connection
+ * @waiter: waiter for the next request to change the todo store
+ * @parked: number of queued responses held until the change of their
+ *          request is applied, see conn_settled
+ * @active: time of the last traffic, in seconds
+ * @reactor: reactor owning the connection
+ * @prev: previous connection in the table of the reactor
+ * @next: next connection in the table of the reactor
+ */
+typedef struct conn_s
+{
+	int          fd;
+	conn_state_t state;
+	int          readable;
+	int          eof;
+	char         address[INET_ADDRSTRLEN];
+	request_buf_t in;
+	response_t  *out;
+	size_t       out_first;
+	size_t       out_count;
+	size_t       out_cap;
+	size_t       out_bytes;
+	size_t       zerocopy;
+	unsigned int zc_next;
+	zc_send_t   *zc;
+	size_t       zc_count;
+	size_t       zc_cap;
+	unsigned long requests;
+	todo_waiter_t *waiter;
+	size_t       parked;
+	long         active;
+	reactor_t   *reactor;
+	struct conn_s *prev;
+	struct conn_s *next;
+} conn_t;
+
+/**
+ * struct reactor_s - event loop thread, one per core
+ * Every reactor has its own listening socket on PORT, bound with
+ * SO_REUSEPORT so the kernel spreads connections among them, its own epoll
+ * instance and its own connection table: reactors share nothing but the
+ * todo store and its log.
+ * @id: reactor number
+ * @thread: thread running the event loop
+ * @alive: 1 while the event loop runs, 0 once it failed and closed
+ *         everything, see reactor_stop, -1 once main joined it
+ * @server_id: listening socket
+ * @epoll_id: epoll instance
+ * @spare_fd: descriptor kept open to be released when out of descriptors,
+ *            see accept_refuse
+ * @paused: when the listening socket left epoll for lack of descriptors,
+ *          0 while it is watched
+ * @wake_fd: eventfd the log thread wakes the reactor up with
+ * @settled: waiters of parked responses told by the log thread, oldest
+ *           first
+ * @settled_last: newest of settled
+ * @settled_lock: protects settled
+ * @conns: connection table, a doubly linked list, most recently active
+ *         connection first
+ * @oldest: least recently active connection, the first to time out
+ * @nb_conns: number of open connections
+ * @accepted: number of connections accepted so far
+ * @requests: number of requests served so far
+ * @reused: number of those served on a connection that served another one
+ * @timeouts: number of connections closed for being idle
+ * @refused: number of connections closed at once for lack of descriptors
+ */
+struct reactor_s
+{
+	int        id;
+	pthread_t  thread;
+	int        alive;
+	int        server_id;
+	int        epoll_id;
+	int        spare_fd;
+	long       paused;
+	int        wake_fd;
+	todo_waiter_t *settled;
+	todo_waiter_t *settled_last;
+	pthread_mutex_t settled_lock;
+	conn_t    *conns;
+	conn_t    *oldest;
+	size_t     nb_conns;
+	unsigned long accepted;
+	unsigned long requests;
+	unsigned long reused;
+	unsigned long timeouts;
+	unsigned long refused;
+};
+
+int     http_respond(char *address, char *request, response_t *res,
+		     todo_waiter_t *waiter);
+void    http_commit(response_t *res, int status);
+int     conn_respond(conn_t *conn);
+void    reactor_settle(reactor_t *reactor);
+conn_t *conn_open(reactor_t *reactor, int fd,
+		  struct sockaddr_in const *addr);
+void    conn_close(conn_t *conn);
+void    zc_enable(conn_t *conn);
+int     zc_reserve(conn_t *conn);
+void    zc_sent(conn_t *conn, response_t *res);
+void    zc_done(conn_t *conn);
+int     zc_reap(conn_t *conn);
+void    zc_release(conn_t *conn);
+void    conn_handle(conn_t *conn, unsigned int events);
+void    conn_sweep(reactor_t *reactor);
+int     listen_socket(void);
+int     reactor_open(reactor_t *reactor);
+void    reactor_close(reactor_t *reactor);
+void   *reactor_run(reactor_t *reactor);
+
+#endif /* _EPOLL_SERVER_H_ */
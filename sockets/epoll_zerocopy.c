@@ -0,0 +1,201 @@
+#include "epoll_server.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+/**
+ * zc_enable - lets a connection send large bodies with MSG_ZEROCOPY, if
+ *             built with a ZEROCOPY_MIN and the kernel supports it
+ *
+ * @conn: connection
+ */
+void zc_enable(conn_t *conn)
+{
+	int on = 1;
+
+	if (ZEROCOPY_MIN > 0 && !setsockopt(conn->fd, SOL_SOCKET, SO_ZEROCOPY,
+		&on, sizeof(on)))
+		conn->zerocopy = ZEROCOPY_MIN;
+}
+
+/**
+ * zc_reserve - makes sure zc_sent will not have to allocate
+ *
+ * @conn: connection
+ * Return: 0 on success, -1 on allocation failure
+ */
+int zc_reserve(conn_t *conn)
+{
+	zc_send_t *tmp;
+
+	if (conn->zc_count < conn->zc_cap)
+		return (0);
+	tmp = realloc(conn->zc, (conn->zc_cap * 2 + 2) * sizeof(*tmp));
+	if (!tmp)
+		return (-1);
+	conn->zc = tmp;
+	conn->zc_cap = conn->zc_cap * 2 + 2;
+	return (0);
+}
+
+/**
+ * zc_current - finds the body of the response being sent, if it was
+ *              already sent in part with MSG_ZEROCOPY
+ *
+ * @conn: connection
+ * Return: its entry, NULL if there is none
+ */
+static zc_send_t *zc_current(conn_t *conn)
+{
+	size_t i;
+
+	for (i = 0; i < conn->zc_count; i++)
+		if (!conn->zc[i].done)
+			return (conn->zc + i);
+	return (NULL);
+}
+
+/**
+ * zc_forget - releases a body the kernel is done with
+ *
+ * @conn: connection
+ * @zc: entry of the body
+ */
+static void zc_forget(conn_t *conn, zc_send_t *zc)
+{
+	if (zc->release)
+		zc->release(zc->owner);
+	*zc = conn->zc[--conn->zc_count];
+}
+
+/**
+ * zc_sent - accounts for a sendmsg() call made with MSG_ZEROCOPY
+ * The body of the response is taken over from it on its first such call,
+ * so that it outlives the response until the kernel is done with it.
+ *
+ * @conn: connection, see zc_reserve
+ * @res: response sent in part
+ */
+void zc_sent(conn_t *conn, response_t *res)
+{
+	zc_send_t *zc = zc_current(conn);
+
+	if (!zc)
+	{
+		zc = conn->zc + conn->zc_count++;
+		memset(zc, 0, sizeof(*zc));
+		zc->first = conn->zc_next;
+		zc->owner = res->owner;
+		zc->release = res->release;
+		res->owner = NULL;
+		res->release = NULL;
+	}
+	zc->last = conn->zc_next++;
+	zc->remaining++;
+}
+
+/**
+ * zc_done - tells that the response being sent is sent entirely
+ *
+ * @conn: connection
+ */
+void zc_done(conn_t *conn)
+{
+	zc_send_t *zc = zc_current(conn);
+
+	if (!zc)
+		return;
+	zc->done = 1;
+	if (!zc->remaining)
+		zc_forget(conn, zc);
+}
+
+/**
+ * zc_complete - accounts for the sendmsg() calls numbered lo to hi,
+ *               which the kernel no longer needs the pages of
+ *
+ * @conn: connection
+ * @lo: first number
+ * @hi: last number
+ */
+static void zc_complete(conn_t *conn, unsigned int lo, unsigned int hi)
+{
+	zc_send_t *zc;
+	unsigned int from, to;
+	size_t i = 0;
+
+	while (i < conn->zc_count)
+	{
+		zc = conn->zc + i;
+		from = lo > zc->first ? lo : zc->first;
+		to = hi < zc->last ? hi : zc->last;
+		if (from <= to && zc->remaining)
+			zc->remaining -= to - from + 1;
+		if (zc->done && !zc->remaining)
+			zc_forget(conn, zc);
+		else
+			i++;
+	}
+}
+
+/**
+ * zc_reap - reads the error queue of a connection on EPOLLERR, where the
+ *           kernel reports MSG_ZEROCOPY completions
+ *
+ * @conn: connection
+ * Return: 0 if that was all there was, -1 if the socket is in error
+ */
+int zc_reap(conn_t *conn)
+{
+	char control[128];
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	struct sock_extended_err *ee;
+	int err = 0;
+	socklen_t len = sizeof(err);
+
+	if (!conn->zerocopy)
+		return (-1);
+	while (1)
+	{
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(conn->fd, &msg, MSG_ERRQUEUE) == -1)
+			break;
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+		{
+			ee = (struct sock_extended_err *)CMSG_DATA(cm);
+			if (ee->ee_errno == 0 &&
+				ee->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+				zc_complete(conn, ee->ee_info, ee->ee_data);
+		}
+	}
+	if (errno != EAGAIN && errno != EWOULDBLOCK)
+		return (-1);
+	if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len) || err)
+		return (-1);
+	return (0);
+}
+
+/**
+ * zc_release - releases every body held for MSG_ZEROCOPY, as the
+ *              connection closes
+ *
+ * @conn: connection
+ */
+void zc_release(conn_t *conn)
+{
+	while (conn->zc_count)
+		zc_forget(conn, conn->zc);
+	free(conn->zc);
+}
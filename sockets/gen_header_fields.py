@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""Generates http_header_fields.c, a perfect hash of the header field names
+of the http_header_field_t enum of sockets.h, the way gperf would.
+
+A name hashes to its length plus the association values of its first and
+last two characters, the same for both cases. The association values are
+searched for so that no two names share a slot.
+
+    ./gen_header_fields.py > http_header_fields.c
+"""
+import re
+import sys
+
+POSITIONS = (0, -2, -1)
+
+
+def field_names(header):
+    """Names of the http_header_field_t enum, '_'s written '-'."""
+    src = open(header).read()
+    body = re.search(r'typedef enum http_header_field_e\s*\{(.*?)\}',
+                     src, re.S).group(1)
+    return [n.strip().replace('_', '-') for n in body.split(',') if n.strip()]
+
+
+def keys_chars(key):
+    return [key[p] for p in POSITIONS]
+
+
+def search(keys, max_value):
+    """Backtracking search of the association values, most used characters
+    first, checking each key once all its characters have a value."""
+    count = {}
+    for key in keys:
+        for c in keys_chars(key):
+            count[c] = count.get(c, 0) + 1
+    order = sorted(count, key=lambda c: (-count[c], c))
+    rank = {c: i for i, c in enumerate(order)}
+    ready = [[] for _ in order]
+    for key in keys:
+        ready[max(rank[c] for c in keys_chars(key))].append(key)
+    asso, used = {}, set()
+
+    def assign(i):
+        if i == len(order):
+            return True
+        for value in range(max_value):
+            asso[order[i]] = value
+            added = []
+            for key in ready[i]:
+                h = len(key) + sum(asso[c] for c in keys_chars(key))
+                if h in used:
+                    break
+                used.add(h)
+                added.append(h)
+            else:
+                if assign(i + 1):
+                    return True
+            used.difference_update(added)
+        del asso[order[i]]
+        return False
+
+    return asso if assign(0) else None
+
+
+def rows(values, width=16):
+    return '\n'.join('\t' + ', '.join(str(v) for v in values[i:i + width]) +
+                     ',' for i in range(0, len(values), width))
+
+
+def packed_rows(values):
+    """Rows of as many values as fit in 80 columns."""
+    lines, line = [], ''
+    for v in values:
+        item = '%s%s,' % (' ' if line else '', v)
+        if 8 + len(line) + len(item) > 80:
+            lines.append('\t' + line)
+            line, item = '', v + ','
+        line += item
+    return '\n'.join(lines + ['\t' + line])
+
+
+def main():
+    names = field_names('sockets.h')
+    keys = [n.lower() for n in names]
+    asso = None
+    for max_value in range(len(keys) // 2, 256):
+        asso = search(keys, max_value)
+        if asso:
+            break
+    hashes = [len(k) + sum(asso[c] for c in keys_chars(k)) for k in keys]
+    size = max(hashes) + 1
+    table = [0] * 256
+    for c, v in asso.items():
+        table[ord(c)] = table[ord(c.upper())] = v
+    slots = ['NONE'] * size
+    for i, h in enumerate(hashes):
+        slots[h] = names[i].replace('-', '_')
+
+    out = sys.stdout
+    out.write('''#include "sockets.h"
+#include <strings.h>
+
+/*
+ * Perfect hash of the header field names of http_header_field_t, generated
+ * by gen_header_fields.py: edit the enum and run it again rather than
+ * editing this file.
+ */
+
+#define HTTP_FIELD_SLOTS %d
+#define HTTP_FIELD_MIN_LEN %d
+#define HTTP_FIELD_MAX_LEN %d
+
+static unsigned char const http_field_asso[256] = {
+%s
+};
+
+#define NONE NUM_HTTP_HEADER_FIELDS
+
+static unsigned char const http_field_slots[HTTP_FIELD_SLOTS] = {
+%s
+};
+
+#undef NONE
+
+static char const * const http_field_names[NUM_HTTP_HEADER_FIELDS] = {
+%s
+};
+
+/**
+ * http_header_field - maps a header field name to its http_header_field_t
+ *                     with a single probe of a perfect hash table
+ * Field names are case-insensitive.
+ *
+ * @name: field name, not necessarily NUL-terminated
+ * @len: length of the name
+ * Return: the field, NUM_HTTP_HEADER_FIELDS if it is not a standard one
+ */
+http_header_field_t http_header_field(char const *name, size_t len)
+{
+	unsigned char const *s = (unsigned char const *)name;
+	char const *known;
+	size_t hash;
+
+	if (len < HTTP_FIELD_MIN_LEN || len > HTTP_FIELD_MAX_LEN)
+		return (NUM_HTTP_HEADER_FIELDS);
+	hash = len + http_field_asso[s[0]] + http_field_asso[s[len - 2]] +
+		http_field_asso[s[len - 1]];
+	if (hash >= HTTP_FIELD_SLOTS ||
+		http_field_slots[hash] == NUM_HTTP_HEADER_FIELDS)
+		return (NUM_HTTP_HEADER_FIELDS);
+	known = http_field_names[http_field_slots[hash]];
+	if (strncasecmp(known, name, len) || known[len])
+		return (NUM_HTTP_HEADER_FIELDS);
+	return (http_field_slots[hash]);
+}
+''' % (size, min(len(k) for k in keys), max(len(k) for k in keys),
+       rows(table), packed_rows(slots),
+       '\n'.join('\t"%s",' % n for n in names)))
+
+
+if __name__ == '__main__':
+    main()
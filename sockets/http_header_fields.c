@@ -0,0 +1,164 @@
+#include "sockets.h"
+#include <strings.h>
+
+/*
+ * Perfect hash of the header field names of http_header_field_t, generated
+ * by gen_header_fields.py: edit the enum and run it again rather than
+ * editing this file.
+ */
+
+#define HTTP_FIELD_SLOTS 102
+#define HTTP_FIELD_MIN_LEN 2
+#define HTTP_FIELD_MAX_LEN 32
+
+static unsigned char const http_field_asso[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 28, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 35, 0, 18, 8, 34, 12, 0, 22, 37, 35, 2, 37,
+	25, 0, 4, 0, 33, 25, 1, 31, 3, 31, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 35, 0, 18, 8, 34, 12, 0, 22, 37, 35, 2, 37,
+	25, 0, 4, 0, 33, 25, 1, 31, 3, 31, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#define NONE NUM_HTTP_HEADER_FIELDS
+
+static unsigned char const http_field_slots[HTTP_FIELD_SLOTS] = {
+	NONE, NONE, NONE, NONE, NONE, NONE, NONE, Expires, Alt_Svc, NONE,
+	Server, Age, ETag, Accept_Ranges, NONE, Referer, Via, Range, Cookie,
+	Retry_After, X_Frame_Options, Content_Range, Set_Cookie,
+	Accept_Language, Content_Language, Accept_Encoding, Content_Encoding,
+	NONE, If_Range, If_Modified_Since, Access_Control_Max_Age,
+	If_Unmodified_Since, Access_Control_Allow_Headers,
+	Access_Control_Expose_Headers, Access_Control_Request_Headers, Prefer,
+	NONE, Content_Type, NONE, Expect, Vary, Access_Control_Allow_Origin,
+	Public_Key_Pins, Accept_CH, Trailer, Delta_Base, Accept_Patch,
+	Accept_Charset, Warning, Connection, Accept_Datetime, A_IM,
+	Authorization, P3P, If_Match, Content_Location, HTTP2_Settings, Origin,
+	Content_Disposition, If_None_Match, Transfer_Encoding, IM, Forwarded,
+	Access_Control_Allow_Methods, Accept, Link, Pragma, Upgrade, TE,
+	Access_Control_Allow_Credentials, User_Agent, Host, Date, Allow,
+	Content_MD5, NONE, Proxy_Authenticate, NONE, Preference_Applied, NONE,
+	WWW_Authenticate, Content_Length, Max_Forwards, Proxy_Authorization,
+	Location, Last_Modified, NONE, Cache_Control, NONE,
+	Strict_Transport_Security, Tk, NONE, NONE, NONE, From, NONE, NONE, NONE,
+	NONE, NONE, NONE, Access_Control_Request_Method,
+};
+
+#undef NONE
+
+static char const * const http_field_names[NUM_HTTP_HEADER_FIELDS] = {
+	"A-IM",
+	"Accept",
+	"Accept-CH",
+	"Accept-Charset",
+	"Accept-Datetime",
+	"Accept-Encoding",
+	"Accept-Language",
+	"Accept-Patch",
+	"Accept-Ranges",
+	"Access-Control-Allow-Origin",
+	"Access-Control-Allow-Credentials",
+	"Access-Control-Expose-Headers",
+	"Access-Control-Max-Age",
+	"Access-Control-Allow-Methods",
+	"Access-Control-Allow-Headers",
+	"Access-Control-Request-Method",
+	"Access-Control-Request-Headers",
+	"Age",
+	"Allow",
+	"Alt-Svc",
+	"Authorization",
+	"Cache-Control",
+	"Connection",
+	"Content-Disposition",
+	"Content-Encoding",
+	"Content-Language",
+	"Content-Length",
+	"Content-Location",
+	"Content-MD5",
+	"Content-Range",
+	"Content-Type",
+	"Cookie",
+	"Date",
+	"Delta-Base",
+	"ETag",
+	"Expect",
+	"Expires",
+	"Forwarded",
+	"From",
+	"HTTP2-Settings",
+	"Host",
+	"IM",
+	"If-Match",
+	"If-Modified-Since",
+	"If-None-Match",
+	"If-Range",
+	"If-Unmodified-Since",
+	"Last-Modified",
+	"Link",
+	"Location",
+	"Max-Forwards",
+	"Origin",
+	"P3P",
+	"Pragma",
+	"Prefer",
+	"Preference-Applied",
+	"Proxy-Authenticate",
+	"Proxy-Authorization",
+	"Public-Key-Pins",
+	"Range",
+	"Referer",
+	"Retry-After",
+	"Server",
+	"Set-Cookie",
+	"Strict-Transport-Security",
+	"TE",
+	"Tk",
+	"Trailer",
+	"Transfer-Encoding",
+	"Upgrade",
+	"User-Agent",
+	"Vary",
+	"Via",
+	"WWW-Authenticate",
+	"Warning",
+	"X-Frame-Options",
+};
+
+/**
+ * http_header_field - maps a header field name to its http_header_field_t
+ *                     with a single probe of a perfect hash table
+ * Field names are case-insensitive.
+ *
+ * @name: field name, not necessarily NUL-terminated
+ * @len: length of the name
+ * Return: the field, NUM_HTTP_HEADER_FIELDS if it is not a standard one
+ */
+http_header_field_t http_header_field(char const *name, size_t len)
+{
+	unsigned char const *s = (unsigned char const *)name;
+	char const *known;
+	size_t hash;
+
+	if (len < HTTP_FIELD_MIN_LEN || len > HTTP_FIELD_MAX_LEN)
+		return (NUM_HTTP_HEADER_FIELDS);
+	hash = len + http_field_asso[s[0]] + http_field_asso[s[len - 2]] +
+		http_field_asso[s[len - 1]];
+	if (hash >= HTTP_FIELD_SLOTS ||
+		http_field_slots[hash] == NUM_HTTP_HEADER_FIELDS)
+		return (NUM_HTTP_HEADER_FIELDS);
+	known = http_field_names[http_field_slots[hash]];
+	if (strncasecmp(known, name, len) || known[len])
+		return (NUM_HTTP_HEADER_FIELDS);
+	return (http_field_slots[hash]);
+}
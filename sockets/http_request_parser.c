@@ -1,95 +1,413 @@
 #include "sockets.h"
-#include <stdlib.h>
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+#if !defined(HTTP_NO_SIMD) && (defined(__SSE2__) || defined(__AVX2__))
+#include <immintrin.h>
+#endif
+#include "http_header_fields.c"
 
-http_method_t get_method(char *method_str);
-http_header_t *http_headers_init(char *line);
-http_param_t *http_params_init(char *str);
+#define HTTP_TAB   0x01
+#define HTTP_CTL   0x02 /* Control characters but tab */
+#define HTTP_COLON 0x04
+#define HTTP_SP    0x08
+#define HTTP_QUERY 0x10
+#define HTTP_AMP   0x20
+#define HTTP_EQ    0x40
 
 /**
- * http_request_init - constructs an instance of a http_request_t struct, which
- *                     describes an http request received by the server, by
- *                     parsing the raw HTTP request sent by the client.
+ * struct http_charset_s - Set of bytes delimiting a part of a request
  *
- *                     EXAMPLE:
- *                     * An HTTP Request looks like this:
- *                         <request-method> <request-uri> <http->version>\r\n
- *                         <request-header-field>: <header-value>\r\n
- *                             . . . (as many request headers as needed)
- *                         \r\n
- *                         <request-body>\0
+ * @ranges:  Pairs of inclusive bounds, padded to 16 bytes for SSE loads
+ * @len:     Number of bounds, 16 at most
+ * @classes: Same set, as classes of http_classes
+ */
+typedef struct http_charset_s
+{
+	char          ranges[16];
+	size_t        len;
+	unsigned char classes;
+} http_charset_t;
+
+http_method_t get_method(char const *method_str, size_t len);
+
+/**
+ * http_slice - makes the slice of a raw request between two pointers
  *
- *                     * Here's an example of an HTTP Request:
- *                         POST /todos HTTP/1.1\r\n
- *                         Content-Length: 29\r\n
- *                         \r\n
- *                         title=Hello&description=World
+ * @raw: raw request
+ * @start: first byte of the slice
+ * @end: byte past the slice
+ * Return: the slice
+ */
+static http_slice_t http_slice(char const *raw, char const *start,
+	char const *end)
+{
+	http_slice_t slice;
+
+	slice.off = start - raw;
+	slice.len = end - start;
+	return (slice);
+}
+
+#define T HTTP_TAB
+#define C HTTP_CTL
+#define L HTTP_COLON
+#define S HTTP_SP
+#define Q HTTP_QUERY
+#define A HTTP_AMP
+#define E HTTP_EQ
+
+/*
+ * Classes of the bytes delimiting the parts of a request, looked up one
+ * byte at a time where SIMD scans do not apply.
+ */
+static unsigned char const http_classes[256] = {
+	C, C, C, C, C, C, C, C, C, T, C, C, C, C, C, C,
+	C, C, C, C, C, C, C, C, C, C, C, C, C, C, C, C,
+	S, 0, 0, 0, 0, 0, A, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, L, 0, 0, E, 0, Q,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, C,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#undef T
+#undef C
+#undef L
+#undef S
+#undef Q
+#undef A
+#undef E
+
+/*
+ * Sets of delimiters, as byte ranges for the SIMD scans and as classes for
+ * the scalar one.
+ */
+static http_charset_t const http_set_ctl = {
+	"\0\010\012\037\177\177", 6, HTTP_CTL
+};
+static http_charset_t const http_set_field = {
+	"\0\037\177\177::", 6, HTTP_CTL | HTTP_TAB | HTTP_COLON
+};
+static http_charset_t const http_set_word = {
+	"\0\037\177\177  ", 6, HTTP_CTL | HTTP_TAB | HTTP_SP
+};
+static http_charset_t const http_set_uri = {
+	"\0\037\177\177  ??", 8, HTTP_CTL | HTTP_TAB | HTTP_SP | HTTP_QUERY
+};
+static http_charset_t const http_set_pair = {"&&==", 4, HTTP_AMP | HTTP_EQ};
+static http_charset_t const http_set_amp = {"&&", 2, HTTP_AMP};
+
+/**
+ * http_findchar_scalar - finds the first byte of a set, one byte at a time
  *
- *                     * This function parses the request to create an
- *                     * http_request_t struct. Defined in `./sockets.h`
+ * @p: first byte to look at
+ * @end: byte past the last one
+ * @set: delimiters
+ * Return: pointer to the byte found, end if there is none
+ */
+static inline char const *http_findchar_scalar(char const *p, char const *end,
+	http_charset_t const *set)
+{
+	while (p < end && !(http_classes[(unsigned char)*p] & set->classes))
+		p++;
+	return (p);
+}
+
+#if !defined(HTTP_NO_SIMD) && defined(__AVX2__)
+/**
+ * http_in_ranges_avx2 - tells which of 32 bytes are within a set of ranges:
+ *                       x is in [lo, hi] when min(x, hi) == x and
+ *                       max(x, lo) == x, a single test if lo is 0 or hi
  *
- * @request_string: HTTP request received (as string)
- * Return: pointer to a struct descrbing the request
+ * @x: bytes
+ * @ranges: pairs of inclusive bounds
+ * @ranges_len: number of bounds
+ * Return: mask with the bits of the bytes within the ranges set
  */
-http_request_t *http_request_init(char *request_string)
+static inline unsigned int http_in_ranges_avx2(__m256i x, char const *ranges,
+	size_t ranges_len)
 {
-	http_request_t *request = malloc(sizeof(http_request_t));
-	char *headers, *body, *query;
+	__m256i in = _mm256_setzero_si256(), lo, hi, test;
+	size_t i;
 
-	if (!request)
-		return (NULL);
+#pragma GCC unroll 8
+	for (i = 0; i < ranges_len; i += 2)
+	{
+		lo = _mm256_set1_epi8(ranges[i]);
+		hi = _mm256_set1_epi8(ranges[i + 1]);
+		if (ranges[i] == ranges[i + 1])
+			test = _mm256_cmpeq_epi8(x, lo);
+		else
+			test = _mm256_cmpeq_epi8(_mm256_min_epu8(x, hi), x);
+		if (ranges[i] && ranges[i] != ranges[i + 1])
+			test = _mm256_and_si256(test,
+				_mm256_cmpeq_epi8(_mm256_max_epu8(x, lo), x));
+		in = _mm256_or_si256(in, test);
+	}
+	return (_mm256_movemask_epi8(in));
+}
+#endif
 
-	headers = strstr(request_string, "\r\n");
-	body = strstr(request_string, "\r\n\r\n");
+#if !defined(HTTP_NO_SIMD) && defined(__SSE2__) && !defined(__SSE4_2__)
+/**
+ * http_in_ranges_sse2 - tells which of 16 bytes are within a set of ranges,
+ *                       as http_in_ranges_avx2 does
+ *
+ * @x: bytes
+ * @ranges: pairs of inclusive bounds
+ * @ranges_len: number of bounds
+ * Return: mask with the bits of the bytes within the ranges set
+ */
+static inline unsigned int http_in_ranges_sse2(__m128i x, char const *ranges,
+	size_t ranges_len)
+{
+	__m128i in = _mm_setzero_si128(), lo, hi, test;
+	size_t i;
 
-	if (!headers || !body)
+#pragma GCC unroll 8
+	for (i = 0; i < ranges_len; i += 2)
 	{
-		free(request);
-		return (NULL);
+		lo = _mm_set1_epi8(ranges[i]);
+		hi = _mm_set1_epi8(ranges[i + 1]);
+		if (ranges[i] == ranges[i + 1])
+			test = _mm_cmpeq_epi8(x, lo);
+		else
+			test = _mm_cmpeq_epi8(_mm_min_epu8(x, hi), x);
+		if (ranges[i] && ranges[i] != ranges[i + 1])
+			test = _mm_and_si128(test,
+				_mm_cmpeq_epi8(_mm_max_epu8(x, lo), x));
+		in = _mm_or_si128(in, test);
+	}
+	return (_mm_movemask_epi8(in));
+}
+#endif
+
+/**
+ * http_findchar - finds the first byte within any of a set of ranges, 32
+ *                 bytes at a time with AVX2, then 16 at a time with the
+ *                 range match of SSE4.2 pcmpestri as picohttpparser does,
+ *                 or with SSE2 compares; one at a time for the rest
+ * The instruction sets are those the compiler targets, -mavx2 or -msse4.2
+ * to widen the scans; the function is inlined with constant ranges.
+ *
+ * @p: first byte to look at
+ * @end: byte past the last one
+ * @set: delimiters
+ * Return: pointer to the byte found, end if there is none
+ */
+static inline char const *http_findchar(char const *p, char const *end,
+	http_charset_t const *set)
+{
+#if !defined(HTTP_NO_SIMD) && (defined(__AVX2__) || \
+	(defined(__SSE2__) && !defined(__SSE4_2__)))
+	unsigned int mask;
+#endif
+#if !defined(HTTP_NO_SIMD) && defined(__SSE4_2__)
+	__m128i ranges = _mm_loadu_si128((__m128i const *)set->ranges);
+	int i;
+#endif
+
+#if !defined(HTTP_NO_SIMD) && defined(__AVX2__)
+	for (; end - p >= 32; p += 32)
+	{
+		mask = http_in_ranges_avx2(
+			_mm256_loadu_si256((__m256i const *)p), set->ranges,
+			set->len);
+		if (mask)
+			return (p + __builtin_ctz(mask));
+	}
+#endif
+#if !defined(HTTP_NO_SIMD) && defined(__SSE4_2__)
+	for (; end - p >= 16; p += 16)
+	{
+		i = _mm_cmpestri(ranges, (int)set->len,
+			_mm_loadu_si128((__m128i const *)p), 16,
+			_SIDD_UBYTE_OPS | _SIDD_CMP_RANGES |
+			_SIDD_LEAST_SIGNIFICANT);
+		if (i != 16)
+			return (p + i);
+	}
+#elif !defined(HTTP_NO_SIMD) && defined(__SSE2__)
+	for (; end - p >= 16; p += 16)
+	{
+		mask = http_in_ranges_sse2(_mm_loadu_si128((__m128i const *)p),
+			set->ranges, set->len);
+		if (mask)
+			return (p + __builtin_ctz(mask));
+	}
+#endif
+	return (http_findchar_scalar(p, end, set));
+}
+
+/**
+ * http_params_parse - splits key=value pairs delimited by '&'s into
+ *                     parameters, pairs without '=' being skipped
+ *
+ * @params: parameters to fill
+ * @raw: raw request
+ * @p: first byte of the pairs
+ * @end: byte past the pairs
+ * Return: 0 on success, -1 if there are more than HTTP_MAX_PARAMS pairs
+ */
+static int http_params_parse(http_params_t *params, char const *raw,
+	char const *p, char const *end)
+{
+	char const *eq, *amp;
+	http_param_t *param;
+
+	for (; p < end; p = amp + 1)
+	{
+		eq = http_findchar(p, end, &http_set_pair);
+		amp = eq;
+		if (eq == end || *eq == '&')
+			continue;
+		amp = http_findchar(eq + 1, end, &http_set_amp);
+		if (params->count == HTTP_MAX_PARAMS)
+			return (-1);
+		param = params->items + params->count++;
+		param->key = http_slice(raw, p, eq);
+		param->value = http_slice(raw, eq + 1, amp);
 	}
-	headers += strlen("\r\n");
-	body += strlen("\r\n\r\n");
-
-	request->raw_request = strdup(request_string);
-	request->method_str  = strtok(request_string, " ");
-	request->method      = get_method(request->method_str);
-	request->uri         = strtok(NULL, " ");
-	request->version     = strtok(NULL, "\r\n");
-	request->headers     = http_headers_init(headers);
-	request->body        = *body ? strdup(body) : NULL;
-	request->body_params = http_params_init(body);
-	query = strchr(request->uri, '?'); /* ex: /todos?id=1 */
-	if (query)	/* query -> ?id=1 */
-		*(query++) = '\0'; /* nullify '?' and move query to next char */
-	request->query_params = http_params_init(query); /* query -> id=1 */
-	return (request);
+	return (0);
+}
+
+/**
+ * http_line_end - finds the "\r\n" ending a line, which must hold no other
+ *                 control character than tabs
+ *
+ * @p: first byte of the line
+ * @end: byte past the request
+ * Return: pointer to the '\r', NULL if the line does not end properly
+ */
+static char const *http_line_end(char const *p, char const *end)
+{
+	char const *cr = http_findchar(p, end, &http_set_ctl);
+
+	if (cr + 1 >= end || cr[0] != '\r' || cr[1] != '\n')
+		return (NULL);
+	return (cr);
 }
 
 /**
- * free_http_request - deallocates memory from a heap-alloacted http_request_t
- *                     struct
+ * http_headers_parse - parses header lines up to the empty line ending them
  *
- * @request: pointer to request
+ * @request: request to fill
+ * @p: first byte of the first header line
+ * @end: byte past the request
+ * Return: pointer to the body, NULL on malformed or too many headers
  */
-void free_http_request(http_request_t *request)
+static char const *http_headers_parse(http_request_t *request, char const *p,
+	char const *end)
 {
-	http_param_t *param_tmp;
-	http_header_t *header_tmp;
+	char const *cr, *colon, *value, *value_end;
+	http_header_t *header;
 
-	if (request)
+	while (p < end && *p != '\r')
 	{
-		free(request->raw_request);
-		while (request->body_params)
-		{
-			param_tmp = request->body_params->next;
-			free(request->body_params);
-			request->body_params = param_tmp;
-		}
-		while (request->headers)
-		{
-			header_tmp = request->headers->next;
-			free(request->headers);
-			request->headers = header_tmp;
-		}
-		free(request);
+		colon = http_findchar(p, end, &http_set_field);
+		if (colon == end || *colon != ':' || colon == p ||
+			request->nb_headers == HTTP_MAX_HEADERS)
+			return (NULL);
+		value = colon + 1;
+		while (value < end && (*value == ' ' || *value == '\t'))
+			value++;
+		cr = http_line_end(value, end);
+		if (!cr)
+			return (NULL);
+		value_end = cr;
+		while (value_end > value &&
+			(value_end[-1] == ' ' || value_end[-1] == '\t'))
+			value_end--;
+		header = request->headers + request->nb_headers++;
+		header->field = http_slice(request->raw, p, colon);
+		header->value = http_slice(request->raw, value, value_end);
+		header->id = http_header_field(p, colon - p);
+		if (header->id != NUM_HTTP_HEADER_FIELDS &&
+			!request->fields[header->id])
+			request->fields[header->id] = request->nb_headers;
+		p = cr + 2;
 	}
+	if (p + 1 >= end || p[1] != '\n')
+		return (NULL);
+	return (p + 2);
+}
+
+/**
+ * http_request_parse - describes an http request received by the server, by
+ *                      parsing the raw HTTP request sent by the client.
+ *
+ *                      EXAMPLE:
+ *                      * An HTTP Request looks like this:
+ *                          <request-method> <request-uri> <http->version>\r\n
+ *                          <request-header-field>: <header-value>\r\n
+ *                              . . . (as many request headers as needed)
+ *                          \r\n
+ *                          <request-body>
+ *
+ *                      * Here's an example of an HTTP Request:
+ *                          POST /todos HTTP/1.1\r\n
+ *                          Content-Length: 29\r\n
+ *                          \r\n
+ *                          title=Hello&description=World
+ *
+ *                      * The request is read once, front to back, and every
+ *                      * part of it is recorded as a slice of the raw
+ *                      * request: nothing is allocated, copied or written
+ *                      * to, so any number of threads may parse at once.
+ *                      * Delimiters are looked for 16 or 32 bytes at a time
+ *                      * where the CPU allows, see http_findchar.
+ *
+ * @request: struct to fill, see `./sockets.h`. Parts parsed before an error
+ *           are still set, the others are empty
+ * @raw: raw HTTP request, left untouched
+ * @len: length of the request, body included
+ * Return: 0 on success, -1 if the request is malformed or too large
+ */
+int http_request_parse(http_request_t *request, char const *raw, size_t len)
+{
+	char const *p = raw, *end = raw + len, *sp, *cr, *query;
+
+	memset(request, 0, offsetof(http_request_t, headers));
+	request->query_params.count = request->body_params.count = 0;
+	request->raw = raw;
+	request->method = UNKNOWN;
+	sp = len <= UINT_MAX ? http_findchar(p, end, &http_set_word) : end;
+	if (sp == end || *sp != ' ')
+		return (-1);
+	request->method_str = http_slice(raw, p, sp);
+	request->method = get_method(p, sp - p);
+	p = sp + 1;
+	sp = http_findchar(p, end, &http_set_uri);
+	query = sp < end && *sp == '?' ? sp : NULL; /* ex: /todos?id=1 */
+	if (query)
+		sp = http_findchar(query + 1, end, &http_set_word);
+	if (sp == end || *sp != ' ')
+		return (-1);
+	request->uri = http_slice(raw, p, query ? query : sp);
+	if (query) /* query -> id=1 */
+		request->query = http_slice(raw, query + 1, sp);
+	p = sp + 1;
+	cr = http_line_end(p, end);
+	if (!cr)
+		return (-1);
+	request->version = http_slice(raw, p, cr);
+	p = http_headers_parse(request, cr + 2, end);
+	if (!p)
+		return (-1);
+	request->body = http_slice(raw, p, end);
+	if (http_params_parse(&request->query_params, raw,
+		raw + request->query.off, raw + request->query.off +
+		request->query.len) == -1)
+		return (-1);
+	return (http_params_parse(&request->body_params, raw, p, end));
 }
@@ -1,33 +1,95 @@
 #include "sockets.h"
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/**
+ * http_slice_is - compares a slice of a request with a string
+ *
+ * @request: request the slice is from
+ * @slice: slice
+ * @str: string
+ * Return: true if they are the same, false if not
+ */
+int http_slice_is(http_request_t const *request, http_slice_t slice,
+	char const *str)
+{
+	return (strlen(str) == slice.len &&
+		!memcmp(request->raw + slice.off, str, slice.len));
+}
 
 /**
  * get_header - get value of a header request field if it exists
+ * Fields are indexed while parsing, see http_header_field.
  *
- * @headers: headers in a request
- * @field: desired field value
- * Return: value of field if it exists, NULL if it does not
+ * @request: request
+ * @field: desired field
+ * Return: value of the first header of that field, NULL if there is none
  */
-char *get_header(http_header_t *headers, char *field)
+http_slice_t const *get_header(http_request_t const *request,
+	http_header_field_t field)
 {
-	for (; headers; headers = headers->next)
-		if (strcmp(headers->field, field) == 0)
-			return (headers->value);
+	if ((unsigned int)field >= NUM_HTTP_HEADER_FIELDS ||
+		!request->fields[field])
+		return (NULL);
+	return (&request->headers[request->fields[field] - 1].value);
+}
 
-	return (NULL);
+/**
+ * http_keep_alive - tells whether the connection of a request persists
+ * HTTP/1.1 connections persist unless a Connection header lists "close",
+ * HTTP/1.0 ones only if one lists "keep-alive". Every Connection header
+ * counts, and each holds a comma-separated list of options.
+ *
+ * @request: parsed request
+ * Return: 1 if the connection persists, 0 if it must be closed
+ */
+int http_keep_alive(http_request_t const *request)
+{
+	int keep_alive = !http_slice_is(request, request->version, "HTTP/1.0");
+	char const *p, *end, *token;
+	size_t i, len;
+
+	for (i = 0; i < request->nb_headers; i++)
+	{
+		if (request->headers[i].id != Connection)
+			continue;
+		p = request->raw + request->headers[i].value.off;
+		end = p + request->headers[i].value.len;
+		for (; p < end; p++)
+		{
+			while (p < end && (*p == ' ' || *p == '\t'))
+				p++;
+			for (token = p; p < end && *p != ','; p++)
+				;
+			len = p - token;
+			while (len && (token[len - 1] == ' ' ||
+				token[len - 1] == '\t'))
+				len--;
+			if (len == 5 && !strncasecmp(token, "close", 5))
+				return (0);
+			if (len == 10 && !strncasecmp(token, "keep-alive", 10))
+				keep_alive = 1;
+		}
+	}
+	return (keep_alive);
 }
 
 /**
  * get_param - returns a parameter value from a list of parameters
+ * @request: request the parameters are from
  * @params: parameters
  * @key: key to search for
- * Return: value of key
+ * Return: value of key, NULL if absent
  */
-char *get_param(http_param_t *params, char *key)
+http_slice_t const *get_param(http_request_t const *request,
+	http_params_t const *params, char const *key)
 {
-	for (; params; params = params->next)
-		if (strcmp(params->key, key) == 0)
-			return (params->value);
+	size_t i;
+
+	for (i = 0; i < params->count; i++)
+		if (http_slice_is(request, params->items[i].key, key))
+			return (&params->items[i].value);
 
 	return (NULL);
 }
@@ -36,9 +98,10 @@ char *get_param(http_param_t *params, char *key)
  * get_method - returns http_method_t (enum type) for the request method
  *
  * @method_str: the method (string) from the request
+ * @len: length of the method
  * Return: http_method_t (enum type describing request type (see sockets.h))
  */
-http_method_t get_method(char *method_str)
+http_method_t get_method(char const *method_str, size_t len)
 {
 	char *method_strs[] = {
 		"GET",
@@ -52,91 +115,13 @@ http_method_t get_method(char *method_str)
 	};
 	size_t i, size = sizeof(method_strs) / sizeof(*method_strs);
 
-	if (!method_str || !(*method_str))
+	if (!method_str || !len)
 		return (UNKNOWN);
 
 	for (i = 0; i < size; i++)
-		if (!strcmp(method_strs[i], method_str))
+		if (strlen(method_strs[i]) == len &&
+			!memcmp(method_strs[i], method_str, len))
 			return (i);
 
 	return (UNKNOWN);
 }
-
-/**
- * http_headers_init - creates linked list of http_header_t structs. each node
- *                     in the list is equal to one request header field/value
- *                     pair
- *
- * @line: string of headers
- * Return: head of linked list of http_header_t structs
- **/
-http_header_t *http_headers_init(char *line)
-{
-	http_header_t *tmp, *head = NULL, *prev = NULL;
-	char *next_line;
-
-	while (*line != '\r')
-	{
-		tmp = malloc(sizeof(http_header_t));
-		if (!(*line) || !tmp)
-		{
-			free(tmp);
-			while (head)
-				tmp = head->next, free(head), head = tmp;
-			return (NULL);
-		}
-		next_line  = strstr(line, "\r\n") + 2;
-		tmp->field = strtok(line, ":");
-		tmp->value = strtok(NULL, "\r\n") + 1;
-		tmp->next  = NULL;
-		if (prev)
-			prev->next = tmp;
-		else
-			head = tmp;
-		line = next_line;
-		prev = tmp;
-	}
-
-	return (head);
-}
-
-/**
- * http_params_init - creates linked list of http_param_t structs. each node
- *                     in the list is equal to one key/value parameter pair
- *
- * @str: string of key value pairs, delimited by '&'s
- * Return: head of linked list of http_param_t structs
- **/
-http_param_t *http_params_init(char *str)
-{
-	char *key, *value;
-	http_param_t *head = NULL, *prev = NULL, *tmp;
-
-	if (!str || !(*str))
-		return (NULL);
-
-	for (
-		key = strtok(str, "="), value = strtok(NULL, "&");
-		key && value;
-		key = strtok(NULL, "="), value = strtok(NULL, "&")
-	)
-	{
-		tmp = malloc(sizeof(http_header_t));
-		if (!tmp)
-		{
-			while (head)
-				tmp = head->next, free(head), head = tmp;
-			return (NULL);
-		}
-		tmp->key   = key;
-		tmp->value = value;
-		tmp->next  = NULL;
-		if (prev)
-			prev->next = tmp;
-		else
-			head = tmp;
-		prev = tmp;
-	}
-
-	return (head);
-}
@@ -0,0 +1,310 @@
+#include "http_response.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * response_status - starts a response with its status line
+ *
+ * @res: response to fill
+ * @status: status, e.g. "200 OK"
+ */
+void response_status(response_t *res, char const *status)
+{
+	memset(res, 0, sizeof(*res));
+	res->status_len = snprintf(res->head, RESPONSE_HEAD_MAX,
+		"HTTP/1.1 %s\r\n", status);
+	if (res->status_len >= RESPONSE_HEAD_MAX)
+		res->status_len = RESPONSE_HEAD_MAX - 1;
+	res->head_len = res->status_len;
+}
+
+/**
+ * response_header - adds a header to a response
+ *
+ * @res: response, with its status line
+ * @field: field name
+ * @value: field value
+ */
+void response_header(response_t *res, char const *field, char const *value)
+{
+	int n = snprintf(res->head + res->head_len,
+		RESPONSE_HEAD_MAX - res->head_len, "%s: %s\r\n", field, value);
+
+	if (n > 0 && (size_t)n < RESPONSE_HEAD_MAX - res->head_len)
+		res->head_len += n;
+}
+
+/**
+ * response_body - ends the headers of a response and sets its body, which
+ *                 is not copied and must outlive the response, see
+ *                 response_own
+ *
+ * @res: response, with its status line
+ * @type: Content-Type, NULL for none
+ * @body: body, NULL for none
+ * @len: length of body
+ */
+void response_body(response_t *res, char const *type, char const *body,
+	size_t len)
+{
+	int n;
+
+	if (type)
+		n = snprintf(res->head + res->head_len,
+			RESPONSE_HEAD_MAX - res->head_len,
+			"Content-Length: %lu\r\nContent-Type: %s\r\n\r\n",
+			(unsigned long)len, type);
+	else
+		n = snprintf(res->head + res->head_len,
+			RESPONSE_HEAD_MAX - res->head_len,
+			"Content-Length: %lu\r\n\r\n", (unsigned long)len);
+	if (n > 0 && (size_t)n < RESPONSE_HEAD_MAX - res->head_len)
+		res->head_len += n;
+	res->body = body;
+	res->body_len = body ? len : 0;
+}
+
+/**
+ * stream_release - releases a streamed body, as response_own expects it
+ *
+ * @stream: stream
+ */
+static void stream_release(void *stream)
+{
+	response_stream_t *st = stream;
+
+	if (st->release)
+		st->release(st->state);
+	free(st);
+}
+
+/**
+ * response_stream - ends the headers of a response and streams its body,
+ *                   with Transfer-Encoding: chunked, writing its first chunk
+ * Only a chunk is held at a time: the next one is written once it is sent,
+ * see response_more.
+ *
+ * @res: response, with its status line
+ * @type: Content-Type
+ * @fill: writes the body a part at a time
+ * @state: passed to fill
+ * @release: called with state once the response is released, or NULL
+ * Return: 0 on success, -1 on failure, state then being released
+ */
+int response_stream(response_t *res, char const *type, response_fill_t fill,
+	void *state, void (*release)(void *state))
+{
+	response_stream_t *st = malloc(sizeof(*st));
+	int n;
+
+	if (!st)
+	{
+		if (release)
+			release(state);
+		return (-1);
+	}
+	st->fill = fill;
+	st->state = state;
+	st->release = release;
+	st->done = 0;
+	n = snprintf(res->head + res->head_len,
+		RESPONSE_HEAD_MAX - res->head_len,
+		"Transfer-Encoding: chunked\r\nContent-Type: %s\r\n\r\n",
+		type);
+	if (n > 0 && (size_t)n < RESPONSE_HEAD_MAX - res->head_len)
+		res->head_len += n;
+	res->stream = st;
+	response_own(res, st, stream_release);
+	return (response_more(res) == -1 ? -1 : 0);
+}
+
+/**
+ * response_more - writes the next chunk of a streamed body, once the
+ *                 current one is sent
+ *
+ * @res: response
+ * Return: 1 if there is a chunk to send, 0 once the body is sent entirely
+ *         or if it is not streamed, -1 on failure
+ */
+int response_more(response_t *res)
+{
+	response_stream_t *st = res->stream;
+	char *data, size[24];
+	ssize_t n;
+	int len;
+
+	if (!st || st->done)
+		return (0);
+	data = st->data + 16; /* Room for the size line */
+	n = st->fill(st->state, data, RESPONSE_CHUNK_MAX);
+	if (n == -1)
+		return (-1);
+	res->sent -= res->body_len;
+	if (!n)
+	{
+		st->done = 1;
+		res->body = "0\r\n\r\n";
+		res->body_len = 5;
+		return (1);
+	}
+	len = sprintf(size, "%lx\r\n", (unsigned long)n);
+	memcpy(data - len, size, len);
+	memcpy(data + n, "\r\n", 2);
+	res->body = data - len;
+	res->body_len = len + n + 2;
+	return (1);
+}
+
+/**
+ * response_own - hands the body of a response over to it
+ *
+ * @res: response
+ * @owner: what holds the body, e.g. the body itself if malloc'd
+ * @release: called with owner once the response is sent, e.g. free
+ */
+void response_own(response_t *res, void *owner, void (*release)(void *owner))
+{
+	res->owner = owner;
+	res->release = release;
+}
+
+/**
+ * response_text - makes a response of a complete, constant one
+ *
+ * @res: response to fill
+ * @text: status line, headers and empty line, at most RESPONSE_HEAD_MAX
+ *        bytes, without body
+ */
+void response_text(response_t *res, char const *text)
+{
+	char const *eol = strstr(text, "\r\n");
+	size_t len = strlen(text);
+
+	memset(res, 0, sizeof(*res));
+	res->head_len = len < RESPONSE_HEAD_MAX ? len : RESPONSE_HEAD_MAX;
+	memcpy(res->head, text, res->head_len);
+	res->status_len = eol ? (size_t)(eol + 2 - text) : res->head_len;
+	if (res->status_len > res->head_len)
+		res->status_len = res->head_len;
+}
+
+/**
+ * response_len - gives the length of a whole response
+ *
+ * @res: response
+ * Return: number of bytes to send
+ */
+size_t response_len(response_t const *res)
+{
+	size_t connection = res->connection ? strlen(res->connection) : 0;
+
+	return (res->head_len + connection + res->body_len);
+}
+
+/**
+ * response_iov - describes what is left to send of a response
+ *
+ * @res: response
+ * @iov: RESPONSE_IOV entries to fill
+ * Return: number of entries filled, 0 once it is all sent
+ */
+int response_iov(response_t const *res, struct iovec *iov)
+{
+	char const *base[RESPONSE_IOV];
+	size_t len[RESPONSE_IOV], skip = res->sent;
+	int i, n = 0;
+
+	base[0] = res->head, len[0] = res->status_len;
+	base[1] = res->connection;
+	len[1] = res->connection ? strlen(res->connection) : 0;
+	base[2] = res->head + res->status_len;
+	len[2] = res->head_len - res->status_len;
+	base[3] = res->body, len[3] = res->body_len;
+	for (i = 0; i < RESPONSE_IOV; i++)
+	{
+		if (skip >= len[i])
+		{
+			skip -= len[i];
+			continue;
+		}
+		iov[n].iov_base = (char *)base[i] + skip;
+		iov[n++].iov_len = len[i] - skip;
+		skip = 0;
+	}
+	return (n);
+}
+
+/**
+ * response_advance - accounts for bytes of a response just sent
+ *
+ * @res: response
+ * @n: number of bytes sent, possibly past the end of the response
+ * Return: number of those bytes that belong to the response
+ */
+size_t response_advance(response_t *res, size_t n)
+{
+	size_t left = response_len(res) - res->sent;
+
+	if (n > left)
+		n = left;
+	res->sent += n;
+	return (n);
+}
+
+/**
+ * response_release - releases the body of a response to its owner
+ *
+ * @res: response
+ */
+void response_release(response_t *res)
+{
+	if (res->release)
+		res->release(res->owner);
+	res->release = NULL;
+	res->owner = NULL;
+}
+
+/**
+ * response_flatten - copies a whole response into a single string, for
+ *                    servers that send with send()
+ *
+ * @res: response, which is sent once copied
+ * Return: malloc'd response, NUL-terminated, NULL on failure
+ */
+char *response_flatten(response_t *res)
+{
+	struct iovec iov[RESPONSE_IOV];
+	size_t len = 0, cap = 0;
+	char *str = NULL, *tmp;
+	int i, n, more = 1;
+
+	while (more == 1)
+	{
+		n = response_iov(res, iov);
+		for (i = 0; i < n; i++)
+		{
+			if (len + iov[i].iov_len + 1 > cap)
+			{
+				cap = (len + iov[i].iov_len + 1) * 2;
+				tmp = realloc(str, cap);
+				more = tmp ? 1 : -1;
+				str = tmp ? tmp : str;
+			}
+			if (more == -1)
+				break;
+			memcpy(str + len, iov[i].iov_base, iov[i].iov_len);
+			len += iov[i].iov_len;
+			response_advance(res, iov[i].iov_len);
+		}
+		if (more == 1)
+			more = response_more(res);
+	}
+	if (more == -1 || !str)
+	{
+		free(str);
+		return (NULL);
+	}
+	str[len] = '\0';
+	return (str);
+}
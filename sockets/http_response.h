@@ -0,0 +1,93 @@
+#ifndef _HTTP_RESPONSE_H_
+#define _HTTP_RESPONSE_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define RESPONSE_HEAD_MAX 160 /* Status line and headers */
+#define RESPONSE_IOV 4 /* Status line, Connection, other headers, body */
+#define RESPONSE_CHUNK_MAX 16384 /* Data per chunk of a streamed body */
+
+/**
+ * response_fill_t - writes the next part of a streamed body
+ * @state: state of the stream
+ * @buf: where to write
+ * @cap: at most that many bytes, at least 1
+ * Return: number of bytes written, 0 once the body is complete, -1 on
+ *         failure
+ */
+typedef ssize_t (*response_fill_t)(void *state, char *buf, size_t cap);
+
+/**
+ * struct response_stream_s - body sent with Transfer-Encoding: chunked,
+ *                            written a chunk at a time as the previous one
+ *                            is sent
+ * @fill: writes the data of the next chunk
+ * @state: passed to fill
+ * @release: called with state once the response is released, or NULL
+ * @done: set once the last chunk is written
+ * @data: chunk, size line and CRLF included
+ */
+typedef struct response_stream_s
+{
+	response_fill_t fill;
+	void          *state;
+	void         (*release)(void *state);
+	int            done;
+	char           data[16 + RESPONSE_CHUNK_MAX + 2];
+} response_stream_t;
+
+/**
+ * struct response_s - HTTP response, kept in pieces to be sent by a single
+ *                     writev()/sendmsg() rather than copied into one buffer
+ * The body is not copied either: it stays wherever it was built, and is
+ * released through its owner once sent.
+ * @head: status line, then the headers and the empty line ending them
+ * @status_len: length of the status line in head
+ * @head_len: length of head
+ * @connection: Connection header, sent between the status line and the
+ *              other headers, or NULL
+ * @body: body, not NUL-terminated
+ * @body_len: length of body
+ * @owner: what holds the body, passed to release
+ * @release: called with owner once the response is sent, or NULL
+ * @stream: streamed body, whose current chunk is body, or NULL
+ * @sent: number of bytes already sent, of the current chunk for the body
+ *        of a stream
+ * @hold: what the response waits for before being sent, NULL if nothing
+ */
+typedef struct response_s
+{
+	char         head[RESPONSE_HEAD_MAX];
+	size_t       status_len;
+	size_t       head_len;
+	char const  *connection;
+	char const  *body;
+	size_t       body_len;
+	void        *owner;
+	void       (*release)(void *owner);
+	response_stream_t *stream;
+	size_t       sent;
+	void        *hold;
+} response_t;
+
+void    response_status(response_t *res, char const *status);
+void    response_header(response_t *res, char const *field,
+			char const *value);
+void    response_body(response_t *res, char const *type, char const *body,
+		      size_t len);
+int     response_stream(response_t *res, char const *type,
+			response_fill_t fill, void *state,
+			void (*release)(void *state));
+int     response_more(response_t *res);
+void    response_own(response_t *res, void *owner,
+		     void (*release)(void *owner));
+void    response_text(response_t *res, char const *text);
+size_t  response_len(response_t const *res);
+int     response_iov(response_t const *res, struct iovec *iov);
+size_t  response_advance(response_t *res, size_t n);
+void    response_release(response_t *res);
+char   *response_flatten(response_t *res);
+
+#endif /* _HTTP_RESPONSE_H_ */
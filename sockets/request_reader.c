@@ -0,0 +1,138 @@
+#include "request_reader.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+
+/**
+ * request_check - finds out whether a buffer starts with a complete request
+ * A request is complete once its headers and Content-Length bytes of body
+ * are in, which may take any number of TCP segments.
+ *
+ * @buf: bytes received so far, NUL-terminated
+ * @len: number of bytes received
+ * @total: set to the length of the request if complete, 0 otherwise
+ * Return: 0, or the status to reject the request with: 431 if its headers
+ *         exceed HEADERS_MAX, 413 if its body exceeds BODY_MAX, 400 if its
+ *         Content-Length is not a number
+ */
+int request_check(char const *buf, size_t len, size_t *total)
+{
+	char const *end = strstr(buf, "\r\n\r\n"), *line, *value;
+	unsigned long body = 0;
+	char *num_end;
+	size_t head;
+
+	*total = 0;
+	if (!end)
+		return (len > HEADERS_MAX ? 431 : 0);
+	head = end + 4 - buf;
+	if (head > HEADERS_MAX)
+		return (431);
+	for (line = strstr(buf, "\r\n"); line < end;
+		line = strstr(line + 2, "\r\n"))
+	{
+		if (strncasecmp(line + 2, "Content-Length:", 15))
+			continue;
+		value = line + 17;
+		while (*value == ' ' || *value == '\t')
+			value++;
+		errno = 0;
+		body = strtoul(value, &num_end, 10);
+		while (*num_end == ' ' || *num_end == '\t')
+			num_end++;
+		if (!isdigit((unsigned char)*value) || *num_end != '\r' ||
+			errno)
+			return (400);
+		if (body > BODY_MAX)
+			return (413);
+	}
+	if (head + body <= len)
+		*total = head + body;
+	return (0);
+}
+
+/**
+ * request_reserve - makes room in a request buffer for more bytes,
+ *                   doubling it up to REQUEST_BUF_MAX
+ *
+ * @req: request buffer, zeroed before its first use
+ * Return: 0 if there is room, -1 if the buffer is full or out of memory
+ */
+int request_reserve(request_buf_t *req)
+{
+	size_t cap = req->cap ? req->cap * 2 : REQUEST_INIT;
+	char *tmp;
+
+	if (req->data && req->len < req->cap)
+		return (0);
+	if (req->cap >= REQUEST_BUF_MAX)
+		return (-1);
+	cap = cap > REQUEST_BUF_MAX ? REQUEST_BUF_MAX : cap;
+	tmp = realloc(req->data, cap + 1);
+	if (!tmp)
+		return (-1);
+	req->data = tmp;
+	req->data[req->len] = '\0';
+	req->cap = cap;
+	return (0);
+}
+
+/**
+ * request_recv - receives one whole request on a blocking socket
+ * Bytes past the request, if the client already sent more, are dropped.
+ *
+ * @fd: client socket
+ * @req: request buffer, reused from one request to the next
+ * Return: 0 once the request is in req->data, NUL-terminated, the status to
+ *         reject it with (see request_check), -1 if the client went away
+ *         first or on failure
+ */
+int request_recv(int fd, request_buf_t *req)
+{
+	size_t total;
+	ssize_t n;
+	int status;
+
+	req->len = 0;
+	if (request_reserve(req) == -1)
+		return (-1);
+	*req->data = '\0';
+	while (!(status = request_check(req->data, req->len, &total)) &&
+		!total)
+	{
+		if (request_reserve(req) == -1)
+			return (-1);
+		n = recv(fd, req->data + req->len, req->cap - req->len, 0);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n == 0)
+			errno = ECONNRESET;
+		if (n <= 0)
+			return (-1);
+		req->len += n;
+		req->data[req->len] = '\0';
+	}
+	if (!status)
+		req->data[total] = '\0';
+	return (status);
+}
+
+/**
+ * request_reject - gives the response rejecting a request
+ *
+ * @status: status returned by request_check
+ * Return: the whole response, without body
+ */
+char const *request_reject(int status)
+{
+	if (status == 413)
+		return ("HTTP/1.1 413 Payload Too Large\r\n"
+			"Content-Length: 0\r\n\r\n");
+	if (status == 431)
+		return ("HTTP/1.1 431 Request Header Fields Too Large\r\n"
+			"Content-Length: 0\r\n\r\n");
+	return ("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n");
+}
@@ -0,0 +1,33 @@
+#ifndef _REQUEST_READER_H_
+#define _REQUEST_READER_H_
+
+#include <stddef.h>
+
+#define REQUEST_INIT 1024 /* Initial size of a request buffer */
+#ifndef HEADERS_MAX
+#define HEADERS_MAX 8192 /* Request line and headers, 431 over that */
+#endif
+#ifndef BODY_MAX
+#define BODY_MAX 1048576 /* Content-Length, 413 over that */
+#endif
+#define REQUEST_BUF_MAX (HEADERS_MAX + BODY_MAX)
+
+/**
+ * struct request_buf_s - growable buffer requests are received into
+ * @data: bytes received, always NUL-terminated once allocated
+ * @len: number of bytes received
+ * @cap: size of the buffer, not counting the NUL byte
+ */
+typedef struct request_buf_s
+{
+	char   *data;
+	size_t  len;
+	size_t  cap;
+} request_buf_t;
+
+int         request_check(char const *buf, size_t len, size_t *total);
+int         request_reserve(request_buf_t *req);
+int         request_recv(int fd, request_buf_t *req);
+char const *request_reject(int status);
+
+#endif /* _REQUEST_READER_H_ */
@@ -75,46 +75,36 @@ void get_resp(int client_fd, todo_info_t *td_info, size_t id)
 
 /**
  * getall_resp - formats str for GET all response
+ * The body is written in one pass into a buffer of its exact size.
  * @client_fd: client file descriptor
  * @td_info: info for todo linked list
  */
 
 void getall_resp(int client_fd, todo_info_t *td_info)
 {
-	char str1[BUFSIZ * 2], str2[BUFSIZ] = {'\0'};
+	char *str;
 	todo_list_t *cur;
-	size_t len = GET_CONSTLEN;
+	size_t len = GET_CONSTLEN, pos;
 
-	if (td_info->head == NULL)
+	for (cur = td_info->head; cur != NULL; cur = cur->next)
+		len += cur->len + (cur != td_info->head);
+	str = malloc(len + BUFSIZ);
+	if (!str)
 	{
-		sprintf(str1, "%s%s%i\r\n%s[]", RESP_GETOK, "Content-Length: ",
-				GET_CONSTLEN, CONTYPE);
-	}
-	else
-	{
-		for (cur = td_info->head; cur != NULL; cur = cur->next)
-		{
-			len += cur->len;
-			if (cur != td_info->head)
-			{
-				++len;
-				sprintf(str1, ",%s%lu%s%s%s%s\"}", "{\"id\":",
-						cur->id, ",\"title\":\"",
-						cur->title,
-						"\",\"description\":\"",
-						cur->desc);
-				strcat(str2, str1);
-			}
-		}
-		sprintf(str1, "%s%s%lu\r\n%s[%s%lu%s%s%s%s\"}%s]",
-				RESP_GETOK, "Content-Length: ",
-				len, CONTYPE, "{\"id\":", td_info->head->id,
-				",\"title\":\"", td_info->head->title,
-				"\",\"description\":\"", td_info->head->desc,
-				str2);
+		send(client_fd, RESP_NOTFOUND, RESP_NOTFOUND_LEN, 0);
+		return;
 	}
+	pos = sprintf(str, "%s%s%lu\r\n%s[", RESP_GETOK, "Content-Length: ",
+			len, CONTYPE);
+	for (cur = td_info->head; cur != NULL; cur = cur->next)
+		pos += sprintf(str + pos, "%s%s%lu%s%s%s%s\"}",
+				cur != td_info->head ? "," : "", "{\"id\":",
+				cur->id, ",\"title\":\"", cur->title,
+				"\",\"description\":\"", cur->desc);
+	str[pos++] = ']';
 	printf("GET /todos -> 200 OK\n");
-	send(client_fd, str1, strlen(str1), 0);
+	send(client_fd, str, pos, 0);
+	free(str);
 }
 
 /**
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include "request_reader.h"
 
 #define GETALL			-2
 #define VERBOSE_OFF		0
@@ -75,7 +76,7 @@ typedef struct todo_info_s
 
 /* sockets.c */
 int init_socket(void);
-int accept_recv(int serv_fd, char *buffer, int mode);
+int accept_recv(int serv_fd, request_buf_t *req, int mode);
 
 /* response.c */
 void post_resp(int client_fd, todo_info_t *td_info);
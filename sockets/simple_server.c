@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "request_reader.h"
+#include "request_reader.c"
 
 #define PORT 8080
 
@@ -25,17 +27,42 @@ static void error_out(char *str, int *server_id, int *client_id)
 	exit(EXIT_FAILURE);
 }
 
+/**
+ * send_all - sends a whole response, however many calls it takes
+ *
+ * @client_id: client socket file descriptor
+ * @buf: response
+ * @len: length of response
+ * Return: 0 on success, -1 on failure
+ */
+static int send_all(int client_id, char const *buf, size_t len)
+{
+	ssize_t n;
+
+	for (; len; buf += n, len -= n)
+	{
+		n = send(client_id, buf, len, MSG_NOSIGNAL);
+		if (n == -1)
+			return (-1);
+	}
+	return (0);
+}
+
 /**
  * take_requests - accepts new connections, responds
+ * A request may come in several segments: it is read into a buffer growing
+ * up to HEADERS_MAX + BODY_MAX bytes until complete, and rejected with 431
+ * or 413 past those limits.
  * @server_id: server socket file descriptor
  *
  */
 void take_requests(int server_id)
 {
-	int client_id;
+	int client_id, status;
 	struct sockaddr_in client_addr;
 	socklen_t addr_size = sizeof(struct sockaddr);
-	char request[1024] = {0}, *response;
+	request_buf_t request = {NULL, 0, 0};
+	char *address, *response;
 
 	while (1)
 	{
@@ -43,18 +70,28 @@ void take_requests(int server_id)
 		if (client_id == -1)
 			error_out("Accept", &server_id, NULL);
 
-
-		if (recv(client_id, request, sizeof(request), 0) == -1)
-			error_out("recv", &server_id, &client_id);
-
-		response = make_response(inet_ntoa(client_addr.sin_addr), request);
-
-		if (send(client_id, response, strlen(response), 0) == -1)
+		status = request_recv(client_id, &request);
+		if (status == -1)
+		{
+			perror("recv"); /* Only this client is lost */
+			close(client_id);
+			continue;
+		}
+		if (status)
+			response = strdup(request_reject(status));
+		else
+		{
+			address = inet_ntoa(client_addr.sin_addr);
+			response = make_response(address, request.data);
+		}
+		if (!response)
+			error_out("Response", &server_id, &client_id);
+
+		if (send_all(client_id, response, strlen(response)) == -1)
 			free(response), error_out("send", &server_id, &client_id);
 
 		close(client_id);
 		free(response);
-		memset(request, '\0', sizeof(request));
 	}
 }
 
@@ -86,6 +123,20 @@ void take_requests(int server_id)
  *             header `Content-Type: application/json`
  *             json representation of the todos in its body
  * ----------------------------------------------------------------------------
+ * GET /todos?limit={limit}&cursor={cursor}
+ *     - Description:      Retrieves a page of the list of todos, in id order
+ *     - Optional queries:
+ *         `limit` -> uint, number of todos, 100 by default, 1000 at most
+ *         `cursor` -> uint, id of the first todo, 0 by default
+ *     - Required headers: None
+ *     - Required body parameters: None
+ *     - Response: 200 OK
+ *         - Response includes:
+ *             header `Content-Type: application/json`
+ *             header `X-Next-Cursor`, cursor of the next page, unless
+ *             this is the last one
+ *             json representation of the todos in its body
+ * ----------------------------------------------------------------------------
  * POST /todos
  *     - Description:      Creates a todo and adds it to the list
  *     - Required queries: None
@@ -101,10 +152,14 @@ void take_requests(int server_id)
  *                 json representation of the created todo in its body
  *         411 Length Required -> Missing the Content-Length header
  *         422 Unprocessable Entity -> Missing a required body parameter
+ *         500 Internal Server Error -> The todo could not be saved
  * ----------------------------------------------------------------------------
  *
  * All other paths/methods should return `404 Not Found`
  *
+ * Todos are saved to todos.log, and todos.snapshot once the log grows, in
+ * the working directory: they are loaded back on the next start.
+ *
  * Return: always zero
  */
 int main(void)
@@ -1,38 +1,50 @@
 #include "rest.h"
+#include "request_reader.c"
 
 /**
  * accept_recv - accept connection and receive message from socket
+ * The whole request is read, however many segments it takes; clients whose
+ * request is too large are answered 431 or 413 and dropped, as are those
+ * leaving before sending a whole request.
  * @serv_fd: server file descriptor
- * @buffer: array to hold message from socket
+ * @req: growable buffer to hold message from socket, reused between calls
  * @mode: specifies whether to print additional information
  * Return: client file descriptor on success, -1 on error
  */
 
-int accept_recv(int serv_fd, char *buffer, int mode)
+int accept_recv(int serv_fd, request_buf_t *req, int mode)
 {
-	int client_fd;
+	int client_fd, status;
 	struct sockaddr_in client_addr;
 	socklen_t client_addrlen = sizeof(client_addr);
+	char const *resp;
 
-	client_fd = accept(serv_fd, (struct sockaddr *) &client_addr,
-			&client_addrlen);
-	if (client_fd == -1)
-	{
-		perror("accept failed");
-		return (-1);
-	}
-	memset(&*buffer, 0, BUFSIZ);
-	if (recv(client_fd, buffer, BUFSIZ, 0) == -1)
+	while (1)
 	{
+		client_fd = accept(serv_fd, (struct sockaddr *) &client_addr,
+				&client_addrlen);
+		if (client_fd == -1)
+		{
+			perror("accept failed");
+			return (-1);
+		}
+		status = request_recv(client_fd, req);
+		if (status == 0)
+			break;
+		if (status == -1)
+			perror("recv failed");
+		else
+		{
+			resp = request_reject(status);
+			send(client_fd, resp, strlen(resp), MSG_NOSIGNAL);
+		}
 		close(client_fd);
-		perror("recv failed");
-		return (-1);
 	}
 	if (mode == VERBOSE_ON)
 	{
 		printf("Client connected: %s\n",
 				inet_ntoa(client_addr.sin_addr));
-		printf("Raw request: \"%s\"\n", buffer);
+		printf("Raw request: \"%s\"\n", req->data);
 	}
 	return (client_fd);
 }
@@ -2,6 +2,9 @@
 #define _SOCKETS_H_
 
 #include <stdlib.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
 
 #define true 1
 #define false 0
@@ -23,6 +26,242 @@ typedef struct todo_s
 	size_t repr_len;
 } todo_t;
 
+/**
+ * struct todo_slot_s - entry of the hash table of a todo store
+ * @id: todo id, -1 if the slot is free
+ * @pos: position of the todo in the dense array
+ */
+typedef struct todo_slot_s
+{
+	int    id;
+	size_t pos;
+} todo_slot_t;
+
+/**
+ * struct todo_record_s - entry of the index of a snapshot file, whose
+ *                        strings follow each other in its heap
+ * @id: todo id
+ * @repr_len: length of repr
+ * @title_len: length of title
+ * @description_len: length of description
+ * @off: offset in the heap of repr, then title, then description, each
+ *       NUL-terminated
+ */
+typedef struct todo_record_s
+{
+	int32_t  id;
+	uint32_t repr_len;
+	uint32_t title_len;
+	uint32_t description_len;
+	uint64_t off;
+} todo_record_t;
+
+/**
+ * struct todo_snapshot_head_s - header of a snapshot file, followed by
+ *                               count records in id order, then the heap
+ * @magic: TODO_SNAPSHOT_MAGIC
+ * @count: number of records
+ * @heap_len: size of the heap
+ * @repr_lens: sum of the repr_len of the records
+ * @next_id: id of the next todo added
+ * @record_size: size of a record
+ */
+typedef struct todo_snapshot_head_s
+{
+	char     magic[8];
+	uint64_t count;
+	uint64_t heap_len;
+	uint64_t repr_lens;
+	int32_t  next_id;
+	uint32_t record_size;
+} todo_snapshot_head_t;
+
+#define TODO_SNAPSHOT_MAGIC "TODOSNP1"
+
+/**
+ * struct todo_snapshot_s - todos a store was loaded with, used in place in
+ *                          the mapping of its snapshot file
+ * Deleting one of them only marks it, the file being mapped read-only.
+ * @map: mapping of the file, NULL if there is none
+ * @map_len: length of map
+ * @records: index, in id order
+ * @len: number of records
+ * @count: number of records not deleted since
+ * @heap: strings of the records
+ * @deleted: bitmap of the records deleted since
+ */
+typedef struct todo_snapshot_s
+{
+	void                *map;
+	size_t               map_len;
+	todo_record_t const *records;
+	size_t               len;
+	size_t               count;
+	char const          *heap;
+	unsigned char       *deleted;
+} todo_snapshot_t;
+
+/**
+ * struct todo_json_s - JSON array of every todo, as GET /todos sends it
+ * A snapshot is shared by the store and the responses being built from it,
+ * and freed by whichever releases it last.
+ * @refs: number of references, the store's included while it holds it
+ * @version: version of the store it was serialized from
+ * @len: length of the JSON
+ * @cap: size of data, the NUL byte included
+ * @data: JSON, NUL-terminated
+ */
+typedef struct todo_json_s
+{
+	size_t        refs;
+	unsigned long version;
+	size_t        len;
+	size_t        cap;
+	char          data[];
+} todo_json_t;
+
+/**
+ * struct todo_store_s - todos by id
+ * Todos loaded from the snapshot file stay in its mapping, see
+ * todo_snapshot_t. Todos added since live in a dense array, in id order
+ * since ids only grow, with holes where todos were deleted until there are
+ * as many holes as todos. An open addressing hash table maps their ids to
+ * their positions in the array. Positions in id order number the records
+ * of the snapshot first, then the array, see todo_store_at.
+ * @base: todos loaded from the snapshot file, older than those of the array
+ * @todos: dense array, a hole's repr is NULL and its id that of the todo
+ *         it held
+ * @len: number of todos and holes in the array
+ * @cap: size of the array
+ * @count: number of todos in the array
+ * @slots: hash table, linear probing
+ * @nb_slots: size of the hash table, a power of 2
+ * @next_id: id of the next todo added
+ * @repr_lens: sum of the repr_len of the todos, base included
+ * @version: number of changes made to the store
+ * @json: last JSON snapshot of the store, current if its version is
+ */
+typedef struct todo_store_s
+{
+	todo_snapshot_t base;
+	todo_t        *todos;
+	size_t         len;
+	size_t         cap;
+	size_t         count;
+	todo_slot_t   *slots;
+	size_t         nb_slots;
+	int            next_id;
+	size_t         repr_lens;
+	unsigned long  version;
+	todo_json_t   *json;
+} todo_store_t;
+
+/**
+ * struct todo_reader_s - position in the JSON array of every todo, as it
+ *                        is streamed a part at a time
+ * The store may change between parts: todos are written in id order, the
+ * ones added or deleted past the position showing up or not.
+ * @next_id: id of the next todo to write, or of where it would be
+ * @count: number of todos written
+ * @started: set once the opening bracket is written
+ * @done: set once the closing bracket is written
+ * @spill: todo that did not fit in the last part, comma included
+ * @spill_len: length of spill
+ * @spill_off: number of bytes of spill written
+ */
+typedef struct todo_reader_s
+{
+	int     next_id;
+	size_t  count;
+	int     started;
+	int     done;
+	char   *spill;
+	size_t  spill_len;
+	size_t  spill_off;
+} todo_reader_t;
+
+/**
+ * struct todo_waiter_s - change waiting to be made durable, then visible
+ * @lsn: number of the log record of the change, 0 until it is logged
+ * @status: 1 while waiting, then 0 once the change is durable and applied
+ *          to the store, -1 if it was dropped
+ * @done: called by the log thread once status is set, NULL to wait with
+ *        todo_log_sync instead
+ * @arg: left for done
+ * @next: next waiter of the log, in lsn order
+ */
+typedef struct todo_waiter_s
+{
+	unsigned long          lsn;
+	int                    status;
+	void                 (*done)(struct todo_waiter_s *waiter);
+	void                  *arg;
+	struct todo_waiter_s  *next;
+} todo_waiter_t;
+
+/**
+ * struct todo_log_s - write-ahead log of the changes made to a todo store
+ * Changes are appended to a memory buffer, and only applied to the store
+ * once durable: the log thread writes and fdatasyncs everything buffered
+ * at once, applies it under the write lock of the store, then tells every
+ * waiter of the batch. A batch that fails is dropped and cut off the log.
+ * Once the log outgrows the snapshot, it is set aside and merged with the
+ * snapshot into a new one by a thread of its own, see log_compact.
+ * @fd: log file, -1 if the store is not persisted
+ * @store: store the changes are applied to
+ * @store_lock: lock of the store
+ * @thread: log thread, writing and applying the changes
+ * @running: set once the log thread is started
+ * @buf: records not written yet
+ * @len: length of buf
+ * @cap: size of buf
+ * @spare: buffer to swap with buf while it is being written
+ * @spare_cap: size of spare
+ * @lsn: number of records appended so far
+ * @next_id: id of the next todo added, ahead of the store's until the
+ *           addition is applied
+ * @waiters: changes waiting, oldest first
+ * @last: newest of waiters
+ * @failed: set while a failed batch could not be cut off the log, no
+ *          change being durable until it is
+ * @compacting: set while the snapshot is being replaced
+ * @size: size of the log file, only used by the log thread
+ * @snapshot_size: size of the snapshot file
+ * @lock: protects the above but fd, failed and size
+ * @pending: signaled when records are appended
+ * @synced: broadcast when waiters without done are told
+ */
+typedef struct todo_log_s
+{
+	int              fd;
+	todo_store_t    *store;
+	pthread_rwlock_t *store_lock;
+	pthread_t        thread;
+	int              running;
+	char            *buf;
+	size_t           len;
+	size_t           cap;
+	char            *spare;
+	size_t           spare_cap;
+	unsigned long    lsn;
+	int              next_id;
+	todo_waiter_t   *waiters;
+	todo_waiter_t   *last;
+	int              failed;
+	int              compacting;
+	size_t           size;
+	size_t           snapshot_size;
+	pthread_mutex_t  lock;
+	pthread_cond_t   pending;
+	pthread_cond_t   synced;
+} todo_log_t;
+
+#define TODO_LOG_ADD     'A'
+#define TODO_LOG_DELETE  'D'
+
+#define TODO_PAGE_DEFAULT 100 /* Todos per page when only a cursor is given */
+#define TODO_PAGE_MAX     1000
+
 /**
  * enum http_method_e - enumeration of HTTP method types
  * @GET:     GET method
@@ -222,55 +461,90 @@ typedef enum http_header_field_e
 	X_Frame_Options
 } http_header_field_t;
 
+#define NUM_HTTP_HEADER_FIELDS (X_Frame_Options + 1)
+
+#define HTTP_MAX_HEADERS 100
+#define HTTP_MAX_PARAMS  32
+
+/**
+ * struct http_slice_s - part of a raw HTTP request, which is never copied
+ * @off: offset of the first byte in the raw request
+ * @len: number of bytes
+ */
+typedef struct http_slice_s
+{
+	unsigned int off;
+	unsigned int len;
+} http_slice_t;
+
 /**
  * struct http_param_s - HTTP body parameter struct
  * @key: parameter key
- * @value: parameter value
- * @next: pointer to next HTTP body parameter struct
+ * @value: parameter value, still URL-encoded
  */
 typedef struct http_param_s
 {
-	char *key;
-	char *value;
-	struct http_param_s *next;
+	http_slice_t key;
+	http_slice_t value;
 } http_param_t;
 
+/**
+ * struct http_params_s - parameters of a query string or body
+ * @count: number of parameters
+ * @items: parameters, in request order
+ */
+typedef struct http_params_s
+{
+	size_t       count;
+	http_param_t items[HTTP_MAX_PARAMS];
+} http_params_t;
+
 /**
  * struct http_header_s - HTTP header struct
- * @field: HTTP header field enum
- * @value: pointer to value of field
- * @next: pointer to next HTTP header struct
+ * @field: header field name
+ * @value: value of field, without surrounding blanks
+ * @id: field, NUM_HTTP_HEADER_FIELDS if it is not a standard one
  */
 typedef struct http_header_s
 {
-	char *field;
-	char *value;
-	struct http_header_s *next;
+	http_slice_t        field;
+	http_slice_t        value;
+	http_header_field_t id;
 } http_header_t;
 
 /**
  * struct http_request_s - struct describing an HTTP request
- * @raw_request: raw request
+ * Every string is a slice of the raw request, which must outlive the
+ * struct: parsing neither allocates nor copies, so a request can live on
+ * the stack of whichever thread serves it.
+ * @raw: raw request
  * @method: HTTP method
- * @method_str: pointer to HTTP method string from original HTTP request
- * @uri: request URI
+ * @method_str: HTTP method string
+ * @uri: request URI, without query string
+ * @query: query string, without '?'
  * @version: HTTP version (string)
- * @headers: linked list of http_header_t structs
- * @body: pointer to HTTP request body
- * @query_params: linked list of http_param_t structs passed via query
- * @body_params: linked list of http_param_t structs passed via body
+ * @body: HTTP request body
+ * @nb_headers: number of headers
+ * @fields: 1 + index in headers of the first header of each standard
+ *          field, 0 if the request has none
+ * @headers: headers, in request order
+ * @query_params: parameters passed via query
+ * @body_params: parameters passed via body
  */
 typedef struct http_request_s
 {
-	char          *raw_request;
+	char const    *raw;
 	http_method_t  method;
-	char          *method_str;
-	char          *uri;
-	char          *version;
-	http_header_t *headers;
-	char          *body;
-	http_param_t  *query_params;
-	http_param_t  *body_params;
+	http_slice_t   method_str;
+	http_slice_t   uri;
+	http_slice_t   query;
+	http_slice_t   version;
+	http_slice_t   body;
+	size_t         nb_headers;
+	unsigned char  fields[NUM_HTTP_HEADER_FIELDS];
+	http_header_t  headers[HTTP_MAX_HEADERS];
+	http_params_t  query_params;
+	http_params_t  body_params;
 } http_request_t;
 
 void   take_requests(int sockid);
@@ -278,8 +552,36 @@ void   print_path_and_queries(char *buffer);
 void   print_headers(char *buffer);
 void   print_body_params(char *buffer);
 int    eval_request(char *buffer, int sockid, int client_id);
-char  *get_param(http_param_t *params, char *key);
-void   add_todo(todo_t *todos, int id, char *title, char *description);
+int    http_request_parse(http_request_t *request, char const *raw,
+			  size_t len);
+int    http_slice_is(http_request_t const *request, http_slice_t slice,
+		     char const *str);
+http_header_field_t http_header_field(char const *name, size_t len);
+http_slice_t const *get_header(http_request_t const *request,
+			       http_header_field_t field);
+int    http_keep_alive(http_request_t const *request);
+http_slice_t const *get_param(http_request_t const *request,
+			      http_params_t const *params, char const *key);
+todo_t *todo_store_add(todo_store_t *store, char const *title,
+		       size_t title_len, char const *description,
+		       size_t description_len);
+todo_t *todo_store_get(todo_store_t const *store, int id, todo_t *view);
+todo_t *todo_store_at(todo_store_t const *store, size_t pos, todo_t *view);
+int     todo_store_delete(todo_store_t *store, int id);
+todo_json_t *todo_store_json(todo_store_t *store);
+ssize_t todo_store_read(todo_store_t const *store, todo_reader_t *reader,
+			char *buf, size_t cap);
+void    todo_store_free(todo_store_t *store);
+int     todo_log_open(todo_log_t *log, todo_store_t *store,
+		      pthread_rwlock_t *store_lock);
+int     todo_log_add(todo_log_t *log, char const *title, size_t title_len,
+		     char const *description, size_t description_len,
+		     todo_waiter_t *waiter);
+int     todo_log_delete(todo_log_t *log, int id, todo_waiter_t *waiter);
+int     todo_log_sync(todo_log_t *log, todo_waiter_t *waiter);
+char   *todo_store_page(todo_store_t const *store, int cursor, size_t limit,
+			size_t *len, int *next);
+void    todo_json_release(todo_json_t *json);
 char  *make_repr(int id, char *title, char *description);
 int    post(char *body, int id, int client_id, int sockid, todo_t *todos);
 
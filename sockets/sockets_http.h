@@ -9,6 +9,7 @@
 #include <sys/types.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include "request_reader.h"
 
 #define PORT 8080
 #define BACKLOG 10
@@ -23,7 +24,7 @@ int create_socket(void);
 int bind_socket(int socket_fd);
 int accept_and_receive(int socket_fd);
 int init_socket(void);
-int accept_recv(int serv_fd, char *buffer, int verbose);
+int accept_recv(int serv_fd, request_buf_t *req, int verbose);
 
 #endif /* __SOCKETS_HTTP_H__ */
 
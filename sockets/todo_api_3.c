@@ -34,18 +34,19 @@ void print_body(char *buffer)
 int accept_connection(int serv_fd)
 {
 	int client_fd;
-	char buffer[BUFSIZ];
+	request_buf_t req = {NULL, 0, 0};
 
 	while (1)
 	{
-		client_fd = accept_recv(serv_fd, buffer, VERBOSE_ON);
+		client_fd = accept_recv(serv_fd, &req, VERBOSE_ON);
 		if (client_fd == -1)
-			return (1);
-		print_body(buffer);
+			break;
+		print_body(req.data);
 		send(client_fd, RESP_OK, RESP_OK_LEN, 0);
 		close(client_fd);
 	}
-	return (0);
+	free(req.data);
+	return (1);
 }
 
 /**
@@ -123,17 +123,18 @@ void parse_req(char *buffer, int client_fd, todo_info_t *td_info)
 int accept_connection(int serv_fd, todo_info_t *td_info)
 {
 	int client_fd;
-	char buffer[BUFSIZ];
+	request_buf_t req = {NULL, 0, 0};
 
 	while (1)
 	{
-		client_fd = accept_recv(serv_fd, buffer, VERBOSE_OFF);
+		client_fd = accept_recv(serv_fd, &req, VERBOSE_OFF);
 		if (client_fd == -1)
-			return (1);
-		parse_req(buffer, client_fd, td_info);
+			break;
+		parse_req(req.data, client_fd, td_info);
 		close(client_fd);
 	}
-	return (0);
+	free(req.data);
+	return (1);
 }
 
 /**
@@ -0,0 +1,820 @@
+#include "sockets.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef TODO_LOG_PATH
+#define TODO_LOG_PATH "todos.log"
+#endif
+#ifndef TODO_SNAPSHOT_PATH
+#define TODO_SNAPSHOT_PATH "todos.snapshot"
+#endif
+#ifndef TODO_LOG_MIN
+#define TODO_LOG_MIN 1048576 /* Log size under which it is never compacted */
+#endif
+
+/*
+ * A record is its payload length and checksum, 32 bits each, then its
+ * payload: operation, todo id, title length and description length, then
+ * title and description. The snapshot is laid out to be used in place, see
+ * todo_snapshot_head_t, in the byte order of the machine. A log set aside
+ * to be merged into the snapshot is LOG_OLD until it is, see log_compact.
+ */
+#define LOG_HEAD  8
+#define LOG_FIXED 13
+#define LOG_OLD TODO_LOG_PATH ".old"
+#define SNAPSHOT_BLOCK 65536 /* Write size of the snapshot */
+
+/**
+ * log_checksum - FNV-1a hash of a record payload
+ *
+ * @data: payload
+ * @len: length of payload
+ * Return: hash
+ */
+static uint32_t log_checksum(char const *data, size_t len)
+{
+	uint32_t hash = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		hash = (hash ^ (unsigned char)data[i]) * 16777619U;
+	return (hash);
+}
+
+/**
+ * log_record - writes a record
+ *
+ * @buf: where to write, LOG_HEAD + LOG_FIXED bytes plus the lengths of
+ *       title and description
+ * @op: operation
+ * @id: todo id
+ * @title: title, not NUL-terminated
+ * @title_len: length of title, 0 for none
+ * @description: description, not NUL-terminated
+ * @description_len: length of description, 0 for none
+ * Return: size of the record
+ */
+static size_t log_record(char *buf, char op, int id, char const *title,
+	uint32_t title_len, char const *description, uint32_t description_len)
+{
+	uint32_t len = LOG_FIXED + title_len + description_len, sum;
+	char *p = buf + LOG_HEAD;
+
+	p[0] = op;
+	memcpy(p + 1, &id, 4);
+	memcpy(p + 5, &title_len, 4);
+	memcpy(p + 9, &description_len, 4);
+	if (title_len)
+		memcpy(p + LOG_FIXED, title, title_len);
+	if (description_len)
+		memcpy(p + LOG_FIXED + title_len, description, description_len);
+	sum = log_checksum(p, len);
+	memcpy(buf, &len, 4);
+	memcpy(buf + 4, &sum, 4);
+	return (LOG_HEAD + len);
+}
+
+/**
+ * log_replay - applies the records of a log to a store
+ * Records already in the snapshot, as after a crash between writing it and
+ * removing the log it merged, change nothing.
+ *
+ * @store: store
+ * @data: records
+ * @len: length of data
+ * Return: length of the valid records, those past it being torn or corrupt
+ */
+static size_t log_replay(todo_store_t *store, char const *data, size_t len)
+{
+	size_t pos = 0;
+	uint32_t size, sum, tlen, dlen;
+	char const *p;
+	int id;
+
+	while (len - pos >= LOG_HEAD + LOG_FIXED)
+	{
+		p = data + pos;
+		memcpy(&size, p, 4);
+		memcpy(&sum, p + 4, 4);
+		if (size < LOG_FIXED || size > len - pos - LOG_HEAD ||
+			log_checksum(p + LOG_HEAD, size) != sum)
+			break;
+		p += LOG_HEAD;
+		memcpy(&id, p + 1, 4);
+		memcpy(&tlen, p + 5, 4);
+		memcpy(&dlen, p + 9, 4);
+		if ((size_t)LOG_FIXED + tlen + dlen != size)
+			break;
+		if (*p == TODO_LOG_ADD && id >= store->next_id)
+		{
+			store->next_id = id;
+			if (!todo_store_add(store, p + LOG_FIXED, tlen,
+				p + LOG_FIXED + tlen, dlen))
+				break;
+		}
+		else if (*p == TODO_LOG_DELETE)
+			todo_store_delete(store, id);
+		pos += LOG_HEAD + size;
+	}
+	return (pos);
+}
+
+/**
+ * log_read - reads a whole file
+ *
+ * @path: path of the file
+ * @len: set to its length
+ * Return: malloc'd contents, NULL if it does not exist or on failure
+ */
+static char *log_read(char const *path, size_t *len)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	char *data = NULL;
+	ssize_t n = 0;
+
+	*len = 0;
+	if (fd == -1)
+		return (NULL);
+	if (fstat(fd, &st) == 0)
+		data = malloc(st.st_size + 1);
+	while (data && *len < (size_t)st.st_size)
+	{
+		n = read(fd, data + *len, st.st_size - *len);
+		if (n <= 0)
+			break;
+		*len += n;
+	}
+	close(fd);
+	return (data);
+}
+
+/**
+ * log_write - writes a whole buffer
+ *
+ * @fd: file descriptor
+ * @buf: buffer
+ * @len: length of buf
+ * Return: 0 on success, -1 on failure
+ */
+static int log_write(int fd, char const *buf, size_t len)
+{
+	ssize_t n;
+
+	for (; len; buf += n, len -= n)
+	{
+		n = write(fd, buf, len);
+		if (n == -1 && errno != EINTR)
+			return (-1);
+		if (n == -1)
+			n = 0;
+	}
+	return (0);
+}
+
+/**
+ * log_sync_dir - makes the entries of the directory of a file durable
+ *
+ * @path: path of the file
+ */
+static void log_sync_dir(char const *path)
+{
+	char dir[4096];
+	char const *slash = strrchr(path, '/');
+	int fd;
+
+	if (!slash)
+		strcpy(dir, ".");
+	else if ((size_t)(slash - path) < sizeof(dir))
+		sprintf(dir, "%.*s", slash > path ? (int)(slash - path) : 1,
+			path);
+	else
+		return;
+	fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (fd == -1)
+		return;
+	fsync(fd);
+	close(fd);
+}
+
+/**
+ * snapshot_valid - checks a snapshot against its size, and its index
+ *                  against its heap
+ * Its todos are used in place, so every record must lie within the heap,
+ * right after the one before it, with its strings NUL-terminated, and the
+ * ids must come in order, as they are searched for.
+ *
+ * @head: header, mapped with the rest of the file
+ * @size: size of the file
+ * Return: 1 if it can be used in place, 0 if not
+ */
+static int snapshot_valid(todo_snapshot_head_t const *head, size_t size)
+{
+	todo_record_t const *record = (todo_record_t const *)(head + 1);
+	char const *heap = (char const *)(record + head->count);
+	uint64_t i, off = 0, repr_lens = 0;
+	int32_t id = -1;
+
+	size -= sizeof(*head);
+	if (memcmp(head->magic, TODO_SNAPSHOT_MAGIC, sizeof(head->magic)) ||
+		head->record_size != sizeof(todo_record_t) ||
+		head->count > size / sizeof(todo_record_t) ||
+		head->heap_len != size - head->count * sizeof(todo_record_t))
+		return (0);
+	for (i = 0; i < head->count; i++, record++)
+	{
+		if (record->id <= id || record->off != off ||
+			head->heap_len - off < 3 + (uint64_t)record->repr_len +
+			record->title_len + record->description_len)
+			return (0);
+		id = record->id;
+		off += record->repr_len;
+		if (heap[off] || heap[off + 1 + record->title_len])
+			return (0);
+		off += record->title_len + record->description_len + 2;
+		if (heap[off++])
+			return (0);
+		repr_lens += record->repr_len;
+	}
+	return (off == head->heap_len && repr_lens == head->repr_lens &&
+		id < head->next_id);
+}
+
+/**
+ * snapshot_replay - loads a snapshot made of log records, as they used to
+ *                   be, into a store
+ *
+ * @store: store, empty
+ * @map: mapping of the snapshot, unmapped
+ * @len: length of map
+ * Return: 1 if every record was replayed, -1 if it is not a snapshot
+ */
+static int snapshot_replay(todo_store_t *store, void *map, size_t len)
+{
+	size_t valid = log_replay(store, map, len);
+
+	munmap(map, len);
+	if (valid == len)
+		return (1);
+	todo_store_free(store); /* Undoes the records replayed */
+	errno = EINVAL;
+	return (-1);
+}
+
+/**
+ * snapshot_map - maps the snapshot of a store, whose todos are used in
+ *                place rather than added one by one, see todo_snapshot_t
+ * The file is renamed into place once complete and durable, see
+ * snapshot_save, but still checked, see snapshot_valid. One that is not a
+ * snapshot may be made of log records, as snapshots used to: it is then
+ * replayed into the store, to be rewritten as a snapshot.
+ *
+ * @store: store, empty
+ * @size: set to the size of the snapshot, 0 if there is none
+ * Return: 0 on success or if there is no snapshot, 1 if it was made of log
+ *         records, -1 on failure
+ */
+static int snapshot_map(todo_store_t *store, size_t *size)
+{
+	todo_snapshot_t *base = &store->base;
+	todo_snapshot_head_t const *head;
+	int fd = open(TODO_SNAPSHOT_PATH, O_RDONLY), ok;
+	void *map = MAP_FAILED;
+	struct stat st;
+
+	*size = 0;
+	if (fd == -1)
+		return (errno == ENOENT ? 0 : -1);
+	ok = !fstat(fd, &st);
+	if (ok && st.st_size)
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (ok && !st.st_size)
+		return (1); /* No records: the store was empty */
+	if (map == MAP_FAILED)
+		return (-1);
+	*size = st.st_size;
+	head = map;
+	if ((size_t)st.st_size < sizeof(*head) ||
+		!snapshot_valid(head, st.st_size))
+		return (snapshot_replay(store, map, st.st_size));
+	base->deleted = calloc(head->count / 8 + 1, 1);
+	if (!base->deleted)
+	{
+		munmap(map, st.st_size);
+		return (-1);
+	}
+	base->map = map;
+	base->map_len = st.st_size;
+	base->records = (todo_record_t const *)(head + 1);
+	base->len = base->count = head->count;
+	base->heap = (char const *)(base->records + base->len);
+	store->next_id = head->next_id;
+	store->repr_lens = head->repr_lens;
+	return (0);
+}
+
+/**
+ * snapshot_put - writes to a snapshot file through a block
+ *
+ * @fd: file descriptor
+ * @block: SNAPSHOT_BLOCK bytes, written once full
+ * @len: length of block
+ * @data: data
+ * @n: length of data
+ * Return: 0 on success, -1 on failure
+ */
+static int snapshot_put(int fd, char *block, size_t *len, void const *data,
+	size_t n)
+{
+	if (*len + n > SNAPSHOT_BLOCK)
+	{
+		if (log_write(fd, block, *len))
+			return (-1);
+		*len = 0;
+	}
+	if (n > SNAPSHOT_BLOCK)
+		return (log_write(fd, data, n));
+	memcpy(block + *len, data, n);
+	*len += n;
+	return (0);
+}
+
+/**
+ * snapshot_write - writes the snapshot of a store to a file: its header,
+ *                  then its index, then its heap
+ *
+ * @fd: file descriptor, of an empty file
+ * @store: store
+ * Return: size written, -1 on failure
+ */
+static ssize_t snapshot_write(int fd, todo_store_t const *store)
+{
+	size_t i, len = 0, total = store->base.len + store->len;
+	todo_snapshot_head_t head;
+	todo_record_t record;
+	todo_t const *todo;
+	todo_t view;
+	char block[SNAPSHOT_BLOCK];
+
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, TODO_SNAPSHOT_MAGIC, sizeof(head.magic));
+	head.count = store->count + store->base.count;
+	head.repr_lens = store->repr_lens;
+	head.next_id = store->next_id;
+	head.record_size = sizeof(record);
+	if (lseek(fd, sizeof(head), SEEK_SET) == -1)
+		return (-1);
+	for (i = 0; i < total; i++)
+	{
+		todo = todo_store_at(store, i, &view);
+		if (!todo)
+			continue;
+		record.id = todo->id;
+		record.repr_len = todo->repr_len;
+		record.title_len = strlen(todo->title);
+		record.description_len = strlen(todo->description);
+		record.off = head.heap_len;
+		head.heap_len += record.repr_len + record.title_len +
+			record.description_len + 3;
+		if (snapshot_put(fd, block, &len, &record, sizeof(record)))
+			return (-1);
+	}
+	for (i = 0; i < total; i++)
+	{
+		todo = todo_store_at(store, i, &view);
+		if (todo && (snapshot_put(fd, block, &len, todo->repr,
+			todo->repr_len + 1) || snapshot_put(fd, block, &len,
+			todo->title, strlen(todo->title) + 1) ||
+			snapshot_put(fd, block, &len, todo->description,
+			strlen(todo->description) + 1)))
+			return (-1);
+	}
+	/* The header goes last, once the size of the heap is known */
+	if ((len && log_write(fd, block, len)) ||
+		pwrite(fd, &head, sizeof(head), 0) != (ssize_t)sizeof(head))
+		return (-1);
+	return (sizeof(head) + head.count * sizeof(record) + head.heap_len);
+}
+
+
+/**
+ * snapshot_save - writes the snapshot of a store aside, then renames it
+ *                 over the snapshot file once durable
+ *
+ * @store: store
+ * Return: size of the snapshot, -1 on failure
+ */
+static ssize_t snapshot_save(todo_store_t const *store)
+{
+	int fd = open(TODO_SNAPSHOT_PATH ".tmp",
+		O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	ssize_t size;
+
+	if (fd == -1)
+		return (-1);
+	size = snapshot_write(fd, store);
+	if (size == -1 || fdatasync(fd))
+		size = -1;
+	if (close(fd) || size == -1 ||
+		rename(TODO_SNAPSHOT_PATH ".tmp", TODO_SNAPSHOT_PATH))
+	{
+		unlink(TODO_SNAPSHOT_PATH ".tmp");
+		return (-1);
+	}
+	log_sync_dir(TODO_SNAPSHOT_PATH);
+	return (size);
+}
+
+/**
+ * log_merge - thread entry writing a new snapshot from the snapshot file
+ *             and the log set aside, see log_compact
+ * Neither file changes any more, so the store is left alone: the snapshot
+ * is mapped again and the log replayed into a store of this thread. The
+ * log set aside is removed last, replaying it over the new snapshot
+ * changing nothing. On failure, compacting stays set: the logs keep every
+ * change until the next start merges them.
+ *
+ * @arg: log
+ * Return: NULL
+ */
+static void *log_merge(void *arg)
+{
+	todo_log_t *log = arg;
+	todo_store_t store;
+	ssize_t size = -1;
+	size_t len;
+	char *data;
+
+	memset(&store, 0, sizeof(store));
+	if (snapshot_map(&store, &len) != -1)
+	{
+		data = log_read(LOG_OLD, &len);
+		if (data && log_replay(&store, data, len) == len)
+			size = snapshot_save(&store);
+		free(data);
+	}
+	todo_store_free(&store);
+	if (size == -1)
+	{
+		perror("Todo snapshot");
+		return (NULL);
+	}
+	if (!unlink(LOG_OLD))
+		log_sync_dir(LOG_OLD);
+	pthread_mutex_lock(&log->lock);
+	log->snapshot_size = size;
+	log->compacting = 0;
+	pthread_mutex_unlock(&log->lock);
+	return (NULL);
+}
+
+/**
+ * log_compact - sets the log aside, to be merged with the snapshot into a
+ *               new one by a thread of its own, see log_merge
+ * Called by the log thread between batches, or before it starts, so that
+ * no record is being written; the log starts over empty. A log already set
+ * aside, by a compaction cut short by a crash, is merged instead.
+ *
+ * @log: log
+ */
+static void log_compact(todo_log_t *log)
+{
+	pthread_t thread;
+	int fd;
+
+	if (access(LOG_OLD, F_OK))
+	{
+		if (rename(TODO_LOG_PATH, LOG_OLD))
+			return;
+		fd = open(TODO_LOG_PATH, O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if (fd == -1)
+		{
+			rename(LOG_OLD, TODO_LOG_PATH);
+			return;
+		}
+		log_sync_dir(TODO_LOG_PATH);
+		close(log->fd);
+		log->fd = fd;
+		log->size = 0;
+	}
+	pthread_mutex_lock(&log->lock);
+	log->compacting = !pthread_create(&thread, NULL, log_merge, log);
+	if (log->compacting)
+		pthread_detach(thread);
+	pthread_mutex_unlock(&log->lock);
+}
+
+/**
+ * log_due - tells whether the log outgrew the snapshot, so that replaying
+ *           them takes longer than replaying a new snapshot
+ *
+ * @log: log, locked
+ * Return: 1 if it is time for log_compact, 0 otherwise
+ */
+static int log_due(todo_log_t const *log)
+{
+	return (log->fd != -1 && !log->failed && !log->compacting &&
+		log->size >= TODO_LOG_MIN && log->size >= log->snapshot_size);
+}
+
+/**
+ * log_commit - makes a batch of records durable, then applies it to the
+ *              store
+ * A batch that cannot be written is cut off the log, or it could show up
+ * after a restart, or hide the batches after it. Until that succeeds,
+ * every batch fails.
+ *
+ * @log: log
+ * @buf: records
+ * @len: length of buf
+ * Return: 0 once the records are durable and applied, -1 if they are
+ *         dropped
+ */
+static int log_commit(todo_log_t *log, char const *buf, size_t len)
+{
+	if (log->fd != -1 && log->failed)
+		log->failed = ftruncate(log->fd, log->size) ||
+			fdatasync(log->fd);
+	if (log->fd != -1 && (log->failed || log_write(log->fd, buf, len) ||
+		fdatasync(log->fd)))
+	{
+		log->failed = ftruncate(log->fd, log->size) ||
+			fdatasync(log->fd);
+		return (-1);
+	}
+	if (log->fd != -1)
+		log->size += len;
+	pthread_rwlock_wrlock(log->store_lock);
+	log_replay(log->store, buf, len);
+	pthread_rwlock_unlock(log->store_lock);
+	return (0);
+}
+
+/**
+ * log_settle - tells the waiters of a batch how it went
+ * Those waiting in todo_log_sync are woken, the others are handed back to
+ * be told once the lock of the log is released.
+ *
+ * @log: log, locked
+ * @batch: number of the last record of the batch
+ * @status: 0 if the batch is applied, -1 if it is dropped
+ * Return: waiters to call done on, in lsn order, linked through next
+ */
+static todo_waiter_t *log_settle(todo_log_t *log, unsigned long batch,
+	int status)
+{
+	todo_waiter_t *waiter, *done = NULL, **last = &done;
+
+	while ((waiter = log->waiters) && waiter->lsn <= batch)
+	{
+		log->waiters = waiter->next;
+		waiter->status = status;
+		if (!waiter->done)
+			continue;
+		*last = waiter;
+		last = &waiter->next;
+	}
+	*last = NULL;
+	if (!log->waiters)
+		log->last = NULL;
+	pthread_cond_broadcast(&log->synced);
+	return (done);
+}
+
+/**
+ * log_run - log thread entry, committing the records appended as batches
+ * Group commit: records appended while a batch is being committed make up
+ * the next one, so a single fdatasync serves every change made meanwhile.
+ *
+ * @arg: log
+ * Return: never returns
+ */
+static void *log_run(void *arg)
+{
+	todo_log_t *log = arg;
+	todo_waiter_t *done, *next;
+	unsigned long batch;
+	size_t len, cap;
+	char *buf;
+	int status, compact;
+
+	pthread_mutex_lock(&log->lock);
+	while (1)
+	{
+		while (!log->len)
+			pthread_cond_wait(&log->pending, &log->lock);
+		buf = log->buf, len = log->len, cap = log->cap;
+		batch = log->lsn;
+		log->buf = log->spare, log->cap = log->spare_cap, log->len = 0;
+		pthread_mutex_unlock(&log->lock);
+		status = log_commit(log, buf, len);
+		pthread_mutex_lock(&log->lock);
+		log->spare = buf, log->spare_cap = cap;
+		done = log_settle(log, batch, status);
+		compact = log_due(log);
+		pthread_mutex_unlock(&log->lock);
+		for (; done; done = next)
+		{
+			next = done->next;
+			done->done(done);
+		}
+		if (compact)
+			log_compact(log);
+		pthread_mutex_lock(&log->lock);
+	}
+	return (NULL);
+}
+
+/**
+ * todo_log_open - loads a store from its snapshot and logs, and starts the
+ *                 log thread for the changes to come
+ * The snapshot is mapped, only the changes since being replayed: those of
+ * a log set aside by a compaction cut short, which is then resumed, and
+ * those of the log. A torn record at the end of the log, from a crash while
+ * it was written, is cut off. A snapshot made of log records, as they used
+ * to be, is rewritten by a compaction right away. If the snapshot cannot be
+ * loaded or the log opened, changes are still made, but not persisted.
+ *
+ * @log: log, zeroed
+ * @store: store, empty
+ * @store_lock: lock of the store, taken to apply changes
+ * Return: 0 on success, -1 if the store is not persisted or cannot change
+ */
+int todo_log_open(todo_log_t *log, todo_store_t *store,
+	pthread_rwlock_t *store_lock)
+{
+	char *data = NULL, *old = NULL;
+	size_t len = 0, old_len, valid = 0;
+	int err, mapped;
+
+	log->fd = -1;
+	log->store = store;
+	log->store_lock = store_lock;
+	pthread_mutex_init(&log->lock, NULL);
+	pthread_cond_init(&log->pending, NULL);
+	pthread_cond_init(&log->synced, NULL);
+	mapped = snapshot_map(store, &log->snapshot_size);
+	if (mapped == -1)
+		perror("Todo snapshot");
+	else
+	{
+		old = log_read(LOG_OLD, &old_len);
+		log_replay(store, old, old_len);
+		data = log_read(TODO_LOG_PATH, &len);
+		valid = log_replay(store, data, len);
+		log->fd = open(TODO_LOG_PATH, O_WRONLY | O_CREAT | O_APPEND,
+			0644);
+	}
+	free(data);
+	if (log->fd != -1 && valid < len &&
+		(ftruncate(log->fd, valid) || fdatasync(log->fd)))
+	{
+		close(log->fd);
+		log->fd = -1;
+	}
+	if (log->fd != -1)
+		log_sync_dir(TODO_LOG_PATH);
+	log->size = valid;
+	log->next_id = store->next_id;
+	if (log->fd != -1 && (old || mapped == 1))
+		log_compact(log);
+	free(old);
+	err = pthread_create(&log->thread, NULL, log_run, log);
+	log->running = !err;
+	if (err)
+		errno = err;
+	return (log->fd != -1 && log->running ? 0 : -1);
+}
+
+/**
+ * log_reserve - makes room for a record at the end of the buffer of a log
+ *
+ * @log: log, locked
+ * @need: size of the record
+ * Return: where to write it, NULL if the log thread is not running or on
+ *         allocation failure
+ */
+static char *log_reserve(todo_log_t *log, size_t need)
+{
+	size_t cap;
+	char *tmp;
+
+	if (!log->running)
+		return (NULL);
+	if (log->len + need > log->cap)
+	{
+		cap = (log->len + need) * 2;
+		tmp = realloc(log->buf, cap);
+		if (!tmp)
+			return (NULL);
+		log->buf = tmp;
+		log->cap = cap;
+	}
+	return (log->buf + log->len);
+}
+
+/**
+ * log_enqueue - numbers the record just appended to a log, queues its
+ *               waiter and wakes the log thread
+ *
+ * @log: log, locked
+ * @waiter: waiter of the change
+ */
+static void log_enqueue(todo_log_t *log, todo_waiter_t *waiter)
+{
+	waiter->lsn = ++log->lsn;
+	waiter->status = 1;
+	waiter->next = NULL;
+	if (log->last)
+		log->last->next = waiter;
+	else
+		log->waiters = waiter;
+	log->last = waiter;
+	pthread_cond_signal(&log->pending);
+}
+
+/**
+ * todo_log_add - logs the addition of a todo, with the next id
+ * The todo only shows up in the store once durable: waiter is told when,
+ * or that it was dropped.
+ *
+ * @log: log
+ * @title: title, not NUL-terminated
+ * @title_len: length of title
+ * @description: description, not NUL-terminated
+ * @description_len: length of description
+ * @waiter: waiter of the addition, its done and arg already set
+ * Return: id of the todo, -1 on failure
+ */
+int todo_log_add(todo_log_t *log, char const *title, size_t title_len,
+	char const *description, size_t description_len,
+	todo_waiter_t *waiter)
+{
+	char *buf;
+	int id = -1;
+
+	pthread_mutex_lock(&log->lock);
+	buf = log_reserve(log, LOG_HEAD + LOG_FIXED + title_len +
+		description_len);
+	if (buf)
+	{
+		id = log->next_id++;
+		log->len += log_record(buf, TODO_LOG_ADD, id, title, title_len,
+			description, description_len);
+		log_enqueue(log, waiter);
+	}
+	pthread_mutex_unlock(&log->lock);
+	return (id);
+}
+
+/**
+ * todo_log_delete - logs the deletion of a todo
+ * The todo stays in the store until the deletion is durable: waiter is told
+ * when, or that it was dropped.
+ *
+ * @log: log
+ * @id: todo id
+ * @waiter: waiter of the deletion, its done and arg already set
+ * Return: 0 on success, -1 on failure
+ */
+int todo_log_delete(todo_log_t *log, int id, todo_waiter_t *waiter)
+{
+	char *buf;
+
+	pthread_mutex_lock(&log->lock);
+	buf = log_reserve(log, LOG_HEAD + LOG_FIXED);
+	if (buf)
+	{
+		log->len += log_record(buf, TODO_LOG_DELETE, id, NULL, 0,
+			NULL, 0);
+		log_enqueue(log, waiter);
+	}
+	pthread_mutex_unlock(&log->lock);
+	return (buf ? 0 : -1);
+}
+
+/**
+ * todo_log_sync - waits until a change is durable and applied, or dropped
+ *
+ * @log: log
+ * @waiter: waiter of the change, without done
+ * Return: 0 once the change is applied, -1 if it was dropped
+ */
+int todo_log_sync(todo_log_t *log, todo_waiter_t *waiter)
+{
+	int status;
+
+	pthread_mutex_lock(&log->lock);
+	while (waiter->status == 1)
+		pthread_cond_wait(&log->synced, &log->lock);
+	status = waiter->status;
+	pthread_mutex_unlock(&log->lock);
+	return (status);
+}
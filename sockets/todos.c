@@ -1,6 +1,8 @@
 #include "sockets.h"
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 
 /**
  * make_repr - makes repr
@@ -24,20 +26,523 @@ char *make_repr(int id, char *title, char *description)
 
 
 /**
- * add_todo - adds todo item
+ * todo_hash - hashes a todo id into the slots of a store
  *
- * @todos: todos
- * @id: id
- * @title: title
- * @description: description
+ * @id: todo id
+ * @nb_slots: size of the hash table, a power of 2
+ * Return: slot to start probing at
+ */
+static size_t todo_hash(int id, size_t nb_slots)
+{
+	return (((size_t)(unsigned int)id * 2654435761UL) & (nb_slots - 1));
+}
+
+/**
+ * todo_store_find - finds the slot of an id
+ *
+ * @store: store
+ * @id: todo id
+ * Return: index of the slot holding the id, or of the free slot ending its
+ *         probe sequence if it is absent
  */
-void add_todo(todo_t *todos, int id, char *title, char *description)
+static size_t todo_store_find(todo_store_t const *store, int id)
 {
-	todo_t *todo = todos + id;
+	size_t i = todo_hash(id, store->nb_slots);
+
+	while (store->slots[i].id != -1 && store->slots[i].id != id)
+		i = (i + 1) & (store->nb_slots - 1);
+	return (i);
+}
 
-	todo->id = id;
-	todo->title = strdup(title);
-	todo->description = strdup(description);
-	todo->repr = make_repr(id, title, description);
+/**
+ * todo_store_rehash - rebuilds the hash table of a store from its array
+ *
+ * @store: store
+ * @nb_slots: new size of the hash table, a power of 2
+ * Return: 0 on success, -1 on allocation failure
+ */
+static int todo_store_rehash(todo_store_t *store, size_t nb_slots)
+{
+	todo_slot_t *slots = malloc(sizeof(*slots) * nb_slots);
+	size_t i, slot;
+
+	if (!slots)
+		return (-1);
+	for (i = 0; i < nb_slots; i++)
+		slots[i].id = -1;
+	free(store->slots);
+	store->slots = slots;
+	store->nb_slots = nb_slots;
+	for (i = 0; i < store->len; i++)
+		if (store->todos[i].repr)
+		{
+			slot = todo_store_find(store, store->todos[i].id);
+			store->slots[slot].id = store->todos[i].id;
+			store->slots[slot].pos = i;
+		}
+	return (0);
+}
+
+/**
+ * todo_json_release - drops a reference to a JSON snapshot, freeing it
+ *                     with the last one
+ *
+ * @json: snapshot, may be NULL
+ */
+void todo_json_release(todo_json_t *json)
+{
+	if (json && !__atomic_sub_fetch(&json->refs, 1, __ATOMIC_ACQ_REL))
+		free(json);
+}
+
+/**
+ * todo_json_append - keeps the JSON snapshot of a store current as a todo
+ *                    is added, by appending it in place
+ * The snapshot is only changed if the store holds the sole reference to
+ * it: one still being sent is left behind, to be rebuilt when next asked.
+ *
+ * @store: store, version not yet bumped for the todo
+ * @todo: todo added, the last of the array
+ */
+static void todo_json_append(todo_store_t *store, todo_t const *todo)
+{
+	todo_json_t *json = store->json, *tmp;
+	size_t cap;
+
+	store->version++;
+	if (!json || json->version != store->version - 1 ||
+		__atomic_load_n(&json->refs, __ATOMIC_ACQUIRE) != 1)
+		return;
+	cap = json->len + todo->repr_len + 2;
+	if (cap > json->cap)
+	{
+		cap *= 2;
+		tmp = realloc(json, sizeof(*json) + cap);
+		if (!tmp)
+			return;
+		json = store->json = tmp;
+		json->cap = cap;
+	}
+	if (store->count + store->base.count > 1)
+		json->data[json->len - 1] = ',';
+	else
+		json->len--;
+	memcpy(json->data + json->len, todo->repr, todo->repr_len);
+	json->len += todo->repr_len;
+	memcpy(json->data + json->len, "]", 2);
+	json->len++;
+	json->version = store->version;
+}
+
+/**
+ * todo_store_json - gives the JSON array of every todo, serializing the
+ *                   store again only if it changed since it last did
+ * Readers may share the store, but not this call: it may replace the
+ * snapshot.
+ *
+ * @store: store
+ * Return: snapshot, to release with todo_json_release, NULL on allocation
+ *         failure
+ */
+todo_json_t *todo_store_json(todo_store_t *store)
+{
+	todo_json_t *json = store->json;
+	todo_t const *todo;
+	todo_t view;
+	size_t cap, i, total = store->base.len + store->len;
+
+	if (!json || json->version != store->version)
+	{
+		/* Brackets, one comma per todo at most and the NUL byte */
+		cap = store->repr_lens + store->count + store->base.count + 3;
+		json = malloc(sizeof(*json) + cap);
+		if (!json)
+			return (NULL);
+		json->refs = 1;
+		json->version = store->version;
+		json->cap = cap;
+		json->data[0] = '[';
+		for (i = 0, json->len = 1; i < total; i++)
+		{
+			todo = todo_store_at(store, i, &view);
+			if (!todo)
+				continue;
+			if (json->len > 1)
+				json->data[json->len++] = ',';
+			memcpy(json->data + json->len, todo->repr,
+				todo->repr_len);
+			json->len += todo->repr_len;
+		}
+		memcpy(json->data + json->len++, "]", 2);
+		todo_json_release(store->json);
+		store->json = json;
+	}
+	__atomic_add_fetch(&json->refs, 1, __ATOMIC_RELAXED);
+	return (json);
+}
+
+/**
+ * todo_store_id - gives the id at a position of a store
+ *
+ * @store: store
+ * @pos: position, see todo_store_at
+ * Return: id of the todo or hole there
+ */
+static int todo_store_id(todo_store_t const *store, size_t pos)
+{
+	if (pos < store->base.len)
+		return (store->base.records[pos].id);
+	return (store->todos[pos - store->base.len].id);
+}
+
+/**
+ * todo_store_at - gives the todo at a position of a store
+ * Todos of the snapshot are described by view, whose strings point into
+ * its mapping.
+ *
+ * @store: store
+ * @pos: position, from 0 to the number of records of the snapshot plus the
+ *       length of the array
+ * @view: filled in if the todo is one of the snapshot
+ * Return: the todo, valid until the store next changes, NULL if there is
+ *         a hole or a deleted record there
+ */
+todo_t *todo_store_at(todo_store_t const *store, size_t pos, todo_t *view)
+{
+	todo_snapshot_t const *base = &store->base;
+	todo_record_t const *record;
+
+	if (pos >= base->len)
+	{
+		pos -= base->len;
+		return (store->todos[pos].repr ? store->todos + pos : NULL);
+	}
+	if (base->deleted[pos / 8] & (1 << pos % 8))
+		return (NULL);
+	record = base->records + pos;
+	view->id = record->id;
+	view->repr = (char *)base->heap + record->off;
+	view->repr_len = record->repr_len;
+	view->title = view->repr + record->repr_len + 1;
+	view->description = view->title + record->title_len + 1;
+	return (view);
+}
+
+/**
+ * todo_store_seek - finds where the todos from an id on start in a store,
+ *                   in O(log n)
+ *
+ * @store: store
+ * @id: todo id
+ * Return: position of the first todo or hole with that id or a greater one
+ */
+static size_t todo_store_seek(todo_store_t const *store, int id)
+{
+	size_t lo = 0, hi = store->base.len + store->len, mid;
+
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (todo_store_id(store, mid) < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo);
+}
+
+/**
+ * todo_store_page - gives the JSON array of at most limit todos, from an
+ *                   id on
+ * Only the page is serialized, so the memory it takes is bounded by limit
+ * whatever the size of the store.
+ *
+ * @store: store
+ * @cursor: id of the first todo, or of where it would be if deleted
+ * @limit: maximum number of todos
+ * @len: set to the length of the JSON
+ * @next: set to the id of the todo following the page, -1 if it is the
+ *        last one
+ * Return: malloc'd JSON, NUL-terminated, NULL on allocation failure
+ */
+char *todo_store_page(todo_store_t const *store, int cursor, size_t limit,
+	size_t *len, int *next)
+{
+	size_t start = todo_store_seek(store, cursor), end, size = 3, n = 0;
+	size_t total = store->base.len + store->len;
+	todo_t const *todo = NULL;
+	todo_t view;
+	char *json;
+
+	for (end = start; end < total && n < limit; end++)
+	{
+		todo = todo_store_at(store, end, &view);
+		if (todo)
+			size += todo->repr_len + 1, n++;
+	}
+	json = malloc(size);
+	if (!json)
+		return (NULL);
+	json[0] = '[';
+	for (*len = 1; start < end; start++)
+	{
+		todo = todo_store_at(store, start, &view);
+		if (!todo)
+			continue;
+		if (*len > 1)
+			json[(*len)++] = ',';
+		memcpy(json + *len, todo->repr, todo->repr_len);
+		*len += todo->repr_len;
+	}
+	memcpy(json + (*len)++, "]", 2);
+	while (end < total && !(todo = todo_store_at(store, end, &view)))
+		end++;
+	*next = end < total ? todo->id : -1;
+	return (json);
+}
+
+/**
+ * todo_store_read - writes the next part of the JSON array of every todo
+ * A todo that does not fit is copied aside and written by the next calls,
+ * in case it is deleted in between.
+ *
+ * @store: store
+ * @reader: position in the array, zeroed before the first call, its spill
+ *          to free if it is not read to the end
+ * @buf: where to write
+ * @cap: at most that many bytes, at least 1
+ * Return: number of bytes written, 0 once the array is complete, -1 on
+ *         allocation failure
+ */
+ssize_t todo_store_read(todo_store_t const *store, todo_reader_t *reader,
+	char *buf, size_t cap)
+{
+	size_t n = 0, pos = todo_store_seek(store, reader->next_id), len;
+	size_t total = store->base.len + store->len;
+	int comma;
+	todo_t const *todo = NULL;
+	todo_t view;
+
+	if (!reader->started)
+		buf[n++] = '[', reader->started = 1;
+	while (n < cap && !reader->done)
+	{
+		if (reader->spill)
+		{
+			len = reader->spill_len - reader->spill_off;
+			len = len < cap - n ? len : cap - n;
+			memcpy(buf + n, reader->spill + reader->spill_off, len);
+			n += len;
+			reader->spill_off += len;
+			if (reader->spill_off < reader->spill_len)
+				break;
+			free(reader->spill);
+			reader->spill = NULL;
+			continue;
+		}
+		while (pos < total &&
+			!(todo = todo_store_at(store, pos, &view)))
+			pos++;
+		if (pos == total)
+		{
+			buf[n++] = ']', reader->done = 1;
+			break;
+		}
+		pos++;
+		reader->next_id = todo->id + 1;
+		comma = reader->count++ ? 1 : 0;
+		if (n + comma + todo->repr_len <= cap)
+		{
+			if (comma)
+				buf[n++] = ',';
+			memcpy(buf + n, todo->repr, todo->repr_len);
+			n += todo->repr_len;
+			continue;
+		}
+		reader->spill = malloc(comma + todo->repr_len);
+		if (!reader->spill)
+			return (-1);
+		reader->spill[0] = ',';
+		memcpy(reader->spill + comma, todo->repr, todo->repr_len);
+		reader->spill_len = comma + todo->repr_len;
+		reader->spill_off = 0;
+	}
+	return (n);
+}
+
+/**
+ * todo_store_add - adds a todo, with the next id, in amortized O(1)
+ * The array and the hash table double when full, the table being kept at
+ * most half full so probe sequences stay short.
+ *
+ * @store: store, zeroed before its first use
+ * @title: title, not NUL-terminated
+ * @title_len: length of title
+ * @description: description, not NUL-terminated
+ * @description_len: length of description
+ * Return: the todo, valid until the store next changes, NULL on
+ *         allocation failure
+ */
+todo_t *todo_store_add(todo_store_t *store, char const *title,
+	size_t title_len, char const *description, size_t description_len)
+{
+	size_t cap = store->cap ? store->cap * 2 : 16, slot;
+	todo_t *todo, *todos;
+
+	if (store->len == store->cap)
+	{
+		todos = realloc(store->todos, sizeof(*todos) * cap);
+		if (!todos)
+			return (NULL);
+		store->todos = todos;
+		store->cap = cap;
+	}
+	if ((store->count + 1) * 2 > store->nb_slots &&
+		todo_store_rehash(store, store->nb_slots ?
+			store->nb_slots * 2 : 32) == -1)
+		return (NULL);
+	todo = store->todos + store->len;
+	todo->id = store->next_id;
+	todo->title = strndup(title, title_len);
+	todo->description = strndup(description, description_len);
+	todo->repr = todo->title && todo->description ?
+		make_repr(todo->id, todo->title, todo->description) : NULL;
+	if (!todo->repr)
+	{
+		free(todo->title);
+		free(todo->description);
+		return (NULL);
+	}
 	todo->repr_len = strlen(todo->repr);
+	slot = todo_store_find(store, todo->id);
+	store->slots[slot].id = todo->id;
+	store->slots[slot].pos = store->len++;
+	store->count++;
+	store->next_id++;
+	store->repr_lens += todo->repr_len;
+	todo_json_append(store, todo);
+	return (todo);
+}
+
+/**
+ * todo_store_get - finds a todo by id, in O(1), or O(log n) among those
+ *                  of the snapshot
+ *
+ * @store: store
+ * @id: todo id
+ * @view: filled in if the todo is one of the snapshot, see todo_store_at
+ * Return: the todo, valid until the store next changes, NULL if absent
+ */
+todo_t *todo_store_get(todo_store_t const *store, int id, todo_t *view)
+{
+	todo_snapshot_t const *base = &store->base;
+	size_t slot;
+
+	if (base->len && id <= base->records[base->len - 1].id)
+	{
+		slot = todo_store_seek(store, id);
+		return (base->records[slot].id == id ?
+			todo_store_at(store, slot, view) : NULL);
+	}
+	if (!store->count)
+		return (NULL);
+	slot = todo_store_find(store, id);
+	if (store->slots[slot].id == -1)
+		return (NULL);
+	return (store->todos + store->slots[slot].pos);
+}
+
+/**
+ * todo_store_compact - closes the holes of the array of a store, updating
+ *                      the slots of the todos it moves
+ *
+ * @store: store
+ */
+static void todo_store_compact(todo_store_t *store)
+{
+	size_t i, len = 0;
+
+	for (i = 0; i < store->len; i++)
+		if (store->todos[i].repr)
+		{
+			store->todos[len] = store->todos[i];
+			store->slots[todo_store_find(store,
+				store->todos[len].id)].pos = len;
+			len++;
+		}
+	store->len = len;
+}
+
+/**
+ * todo_store_delete - deletes a todo by id, in amortized O(1)
+ * Its slot is freed by shifting back the entries probed past it, leaving
+ * no tombstones. The array is compacted once it holds more holes than
+ * todos, which takes as many deletions as it moves todos. A todo of the
+ * snapshot is marked deleted instead, in O(log n).
+ *
+ * @store: store
+ * @id: todo id
+ * Return: 0 on success, -1 if the todo is absent
+ */
+int todo_store_delete(todo_store_t *store, int id)
+{
+	size_t mask = store->nb_slots - 1, i, j, home;
+	todo_t view, *todo = todo_store_get(store, id, &view);
+
+	if (!todo)
+		return (-1);
+	store->repr_lens -= todo->repr_len;
+	store->version++;
+	if (todo == &view)
+	{
+		i = todo_store_seek(store, id);
+		store->base.deleted[i / 8] |= 1 << i % 8;
+		store->base.count--;
+		return (0);
+	}
+	store->count--;
+	free(todo->title);
+	free(todo->description);
+	free(todo->repr);
+	memset(todo, 0, sizeof(*todo));
+	todo->id = id; /* Keeps the array sorted, see todo_store_seek */
+	i = todo_store_find(store, id);
+	for (j = (i + 1) & mask; store->slots[j].id != -1; j = (j + 1) & mask)
+	{
+		home = todo_hash(store->slots[j].id, store->nb_slots);
+		if ((j > i && (home <= i || home > j)) ||
+			(j < i && home <= i && home > j))
+		{
+			store->slots[i] = store->slots[j];
+			i = j;
+		}
+	}
+	store->slots[i].id = -1;
+	if (store->len - store->count > store->count)
+		todo_store_compact(store);
+	return (0);
+}
+
+/**
+ * todo_store_free - releases everything a store holds, leaving it empty
+ *
+ * @store: store
+ */
+void todo_store_free(todo_store_t *store)
+{
+	size_t i;
+
+	for (i = 0; i < store->len; i++)
+	{
+		free(store->todos[i].title);
+		free(store->todos[i].description);
+		free(store->todos[i].repr);
+	}
+	free(store->todos);
+	free(store->slots);
+	free(store->base.deleted);
+	if (store->base.map)
+		munmap(store->base.map, store->base.map_len);
+	todo_json_release(store->json);
+	memset(store, 0, sizeof(*store));
 }